@@ -0,0 +1,226 @@
+#include "BlockCompression.h"
+#include <algorithm> //std::min, std::max, std::swap
+#include <cmath> //std::abs
+
+static std::uint16_t pack_565(const Color& c)
+{
+	// round to the nearest 5/6 bit level
+	int r = (c.r * 31 + 127) / 255;
+	int g = (c.g * 63 + 127) / 255;
+	int b = (c.b * 31 + 127) / 255;
+	return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static inline Color unpack_565(std::uint16_t c)
+{
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	// replicate the high bits so 0 -> 0 and max -> 255
+	return Color(
+		static_cast<std::uint8_t>((r << 3) | (r >> 2)),
+		static_cast<std::uint8_t>((g << 2) | (g >> 4)),
+		static_cast<std::uint8_t>((b << 3) | (b >> 2)));
+}
+
+// (2a + b) / 3, constant weights so the divisions become multiplies
+static inline std::uint8_t third(int a, int b)
+{
+	return static_cast<std::uint8_t>((2 * a + b + 1) / 3);
+}
+
+static inline std::uint8_t half(int a, int b)
+{
+	return static_cast<std::uint8_t>((a + b + 1) / 2);
+}
+
+static int color_distance(const Color& a, const Color& b)
+{
+	int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+	return dr * dr + dg * dg + db * db;
+}
+
+// palette of a color block, returns false for 3 color (punch-through) blocks
+static inline bool color_palette(const std::uint8_t* in, Color palette[4], bool force_four_color)
+{
+	std::uint16_t c0 = static_cast<std::uint16_t>(in[0] | (in[1] << 8));
+	std::uint16_t c1 = static_cast<std::uint16_t>(in[2] | (in[3] << 8));
+	palette[0] = unpack_565(c0);
+	palette[1] = unpack_565(c1);
+	if (c0 > c1 || force_four_color)
+	{
+		palette[2] = Color(third(palette[0].r, palette[1].r), third(palette[0].g, palette[1].g), third(palette[0].b, palette[1].b));
+		palette[3] = Color(third(palette[1].r, palette[0].r), third(palette[1].g, palette[0].g), third(palette[1].b, palette[0].b));
+		return true;
+	}
+	palette[2] = Color(half(palette[0].r, palette[1].r), half(palette[0].g, palette[1].g), half(palette[0].b, palette[1].b));
+	palette[3] = Color(0, 0, 0, 0);
+	return false;
+}
+
+static void encode_color_block(const Color texels[16], std::uint8_t* out)
+{
+	// fit the endpoints along the principal axis of the block's colors (range fit)
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		mean[0] += texels[i].r;
+		mean[1] += texels[i].g;
+		mean[2] += texels[i].b;
+	}
+	for (float& m : mean) m /= 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 }; // rr rg rb gg gb bb
+	for (int i = 0; i < 16; ++i)
+	{
+		float r = texels[i].r - mean[0], g = texels[i].g - mean[1], b = texels[i].b - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	// a few power iterations are plenty for a 3x3 matrix
+	float axis[3] = { 1, 1, 1 };
+	for (int iter = 0; iter < 4; ++iter)
+	{
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+		if (len <= 0.0f) break; // flat block, any axis works
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
+
+	int min_i = 0, max_i = 0;
+	float min_d = 1e30f, max_d = -1e30f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float d = texels[i].r * axis[0] + texels[i].g * axis[1] + texels[i].b * axis[2];
+		if (d < min_d) { min_d = d; min_i = i; }
+		if (d > max_d) { max_d = d; max_i = i; }
+	}
+
+	std::uint16_t c0 = pack_565(texels[max_i]);
+	std::uint16_t c1 = pack_565(texels[min_i]);
+	if (c0 < c1) std::swap(c0, c1);
+
+	out[0] = static_cast<std::uint8_t>(c0 & 0xFF);
+	out[1] = static_cast<std::uint8_t>(c0 >> 8);
+	out[2] = static_cast<std::uint8_t>(c1 & 0xFF);
+	out[3] = static_cast<std::uint8_t>(c1 >> 8);
+	out[4] = out[5] = out[6] = out[7] = 0;
+	if (c0 == c1) return; // solid block, every index 0
+
+	Color palette[4];
+	color_palette(out, palette, false);
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		int best_distance = color_distance(texels[i], palette[0]);
+		for (int p = 1; p < 4; ++p)
+		{
+			int distance = color_distance(texels[i], palette[p]);
+			if (distance < best_distance) { best_distance = distance; best = p; }
+		}
+		out[4 + i / 4] |= static_cast<std::uint8_t>(best << ((i % 4) * 2));
+	}
+}
+
+static void decode_color_block(const std::uint8_t* in, Color texels[16], bool force_four_color)
+{
+	Color palette[4];
+	color_palette(in, palette, force_four_color);
+	std::uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<std::uint32_t>(in[7]) << 24);
+	for (int i = 0; i < 16; ++i, indices >>= 2)
+		texels[i] = palette[indices & 3];
+}
+
+static void encode_alpha_block(const Color texels[16], std::uint8_t* out)
+{
+	std::uint8_t a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; ++i)
+	{
+		a0 = std::max(a0, texels[i].a);
+		a1 = std::min(a1, texels[i].a);
+	}
+
+	out[0] = a0;
+	out[1] = a1;
+	std::uint64_t indices = 0;
+	if (a0 > a1)
+	{
+		// 8 value mode: index 0 = a0, 1 = a1, 2..7 = 6/7 .. 1/7 of the way from a1 to a0
+		for (int i = 0; i < 16; ++i)
+		{
+			// position between a1 (0) and a0 (7), rounded
+			int step = ((texels[i].a - a1) * 14 + (a0 - a1)) / ((a0 - a1) * 2);
+			int index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+			indices |= static_cast<std::uint64_t>(index) << (i * 3);
+		}
+	}
+	for (int b = 0; b < 6; ++b) out[2 + b] = static_cast<std::uint8_t>(indices >> (b * 8));
+}
+
+static void decode_alpha_block(const std::uint8_t* in, Color texels[16])
+{
+	int a0 = in[0], a1 = in[1];
+	std::uint8_t palette[8];
+	palette[0] = static_cast<std::uint8_t>(a0);
+	palette[1] = static_cast<std::uint8_t>(a1);
+	if (a0 > a1)
+	{
+		for (int i = 1; i < 7; ++i) palette[i + 1] = static_cast<std::uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i) palette[i + 1] = static_cast<std::uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	std::uint64_t indices = 0;
+	for (int b = 0; b < 6; ++b) indices |= static_cast<std::uint64_t>(in[2 + b]) << (b * 8);
+	for (int i = 0; i < 16; ++i) texels[i].a = palette[(indices >> (i * 3)) & 7];
+}
+
+void encode_bc1_block(const Color texels[16], std::uint8_t* out)
+{
+	encode_color_block(texels, out);
+}
+
+void encode_bc3_block(const Color texels[16], std::uint8_t* out)
+{
+	encode_alpha_block(texels, out);
+	encode_color_block(texels, out + 8);
+}
+
+void decode_bc1_block(const std::uint8_t* in, Color texels[16])
+{
+	decode_color_block(in, texels, false);
+}
+
+void decode_bc3_block(const std::uint8_t* in, Color texels[16])
+{
+	decode_color_block(in + 8, texels, true);
+	decode_alpha_block(in, texels);
+}
+
+void flip_bc1_block(std::uint8_t* block)
+{
+	// one index byte per row
+	std::swap(block[4], block[7]);
+	std::swap(block[5], block[6]);
+}
+
+void flip_bc3_block(std::uint8_t* block)
+{
+	// alpha indices are 12 bits per row
+	std::uint64_t indices = 0;
+	for (int b = 0; b < 6; ++b) indices |= static_cast<std::uint64_t>(block[2 + b]) << (b * 8);
+
+	std::uint64_t flipped = 0;
+	for (int row = 0; row < 4; ++row)
+		flipped |= ((indices >> (row * 12)) & 0xFFF) << ((3 - row) * 12);
+	for (int b = 0; b < 6; ++b) block[2 + b] = static_cast<std::uint8_t>(flipped >> (b * 8));
+
+	flip_bc1_block(block + 8);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include "Color.h"
+
+// BC1/BC3 (DXT1/DXT5) 4x4 block codecs, texels are in row-major order inside a block
+//
+// BC1, 8 bytes: two rgb565 endpoints + 2 bit index per texel.
+//   color0 > color1: 4 colors, the endpoints and 1/3, 2/3 between them
+//   color0 <= color1: 3 colors (endpoints and midpoint) + transparent black
+// BC3, 16 bytes: alpha block (two 8 bit endpoints + 3 bit index per texel) followed by a BC1 color block
+//   that is always decoded in 4 color mode
+
+const int bc1_block_bytes = 8;
+const int bc3_block_bytes = 16;
+
+// encoder only emits 4 color blocks, alpha is ignored
+void encode_bc1_block(const Color texels[16], std::uint8_t* out);
+void encode_bc3_block(const Color texels[16], std::uint8_t* out);
+
+void decode_bc1_block(const std::uint8_t* in, Color texels[16]);
+void decode_bc3_block(const std::uint8_t* in, Color texels[16]);
+
+// mirror a block top to bottom in place, for files stored with the other row order
+void flip_bc1_block(std::uint8_t* block);
+void flip_bc3_block(std::uint8_t* block);
@@ -0,0 +1,81 @@
+#include "FrameWriter.h"
+#include <iostream>
+
+bool FrameWriter::open(const std::string& filename, int width, int height)
+{
+	bool tga = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".tga") == 0;
+	bool ppm = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".ppm") == 0;
+	if (!tga && !ppm)
+	{
+		std::cerr << "error: " << filename << " should be a .ppm or .tga file" << std::endl;
+		return false;
+	}
+	if (width <= 0 || height <= 0 || (tga && (width > 65535 || height > 65535)))
+	{
+		std::cerr << "error: cant write a " << width << "x" << height << " frame to " << filename
+			<< (tga ? " (tga max 65535, use .ppm)" : "") << std::endl;
+		return false;
+	}
+
+	m_out.open(filename, std::ios::binary);
+	if (!m_out)
+	{
+		std::cerr << "error: cant open file " << filename << " to write" << std::endl;
+		return false;
+	}
+
+	m_filename = filename;
+	m_tga = tga;
+	m_width = width;
+	m_height = height;
+	m_rows_written = 0;
+	m_row.resize(static_cast<std::size_t>(width) * 3);
+
+	if (m_tga)
+	{
+		// same header as Image::write_tga_file, top-left origin since rows come top first
+		std::uint8_t header[18] = { 0 };
+		header[2] = 2; // img type 2, uncompressed true-color
+		header[12] = width & 0xFF;
+		header[13] = (width >> 8) & 0xFF;
+		header[14] = height & 0xFF;
+		header[15] = (height >> 8) & 0xFF;
+		header[16] = 24;
+		header[17] = 0x20;
+		m_out.write(reinterpret_cast<char*>(header), sizeof(header));
+	}
+	else m_out << "P6\n" << width << " " << height << "\n255\n";
+
+	return static_cast<bool>(m_out);
+}
+
+bool FrameWriter::write_row(const Color* pixels)
+{
+	if (!m_out.is_open() || m_rows_written >= m_height) return false;
+
+	// tga is bgr, ppm rgb
+	std::uint8_t* out = m_row.data();
+	for (int x = 0; x < m_width; ++x, out += 3)
+	{
+		out[0] = m_tga ? pixels[x].b : pixels[x].r;
+		out[1] = pixels[x].g;
+		out[2] = m_tga ? pixels[x].r : pixels[x].b;
+	}
+	m_out.write(reinterpret_cast<const char*>(m_row.data()), m_row.size());
+	m_rows_written++;
+	return static_cast<bool>(m_out);
+}
+
+bool FrameWriter::close()
+{
+	if (!m_out.is_open()) return false;
+	m_out.close();
+
+	if (!m_out || m_rows_written != m_height)
+	{
+		std::cerr << "error: something bad happened while writing " << m_filename
+			<< " (" << m_rows_written << " of " << m_height << " rows)" << std::endl;
+		return false;
+	}
+	return true;
+}
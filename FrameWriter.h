@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Color.h"
+
+// streams a frame to disk one row at a time, top row of the picture first, so it never has to be in memory whole.
+// format from the extension:
+//   .ppm binary P6, no size limit (gigapixel output)
+//   .tga uncompressed, top-left origin, up to 65535 x 65535
+//
+// Image rows are stored bottom-up in files (write_tga_file), so the picture's top row is the image's last row
+class FrameWriter {
+public:
+	bool open(const std::string& filename, int width, int height);
+	// next row down, width pixels
+	bool write_row(const Color* pixels);
+	// false if rows are missing or something went wrong while writing
+	bool close();
+
+	int get_rows_written() const { return m_rows_written; }
+
+private:
+	std::ofstream m_out;
+	std::string m_filename;
+	bool m_tga = false;
+	int m_width = 0;
+	int m_height = 0;
+	int m_rows_written = 0;
+	std::vector<std::uint8_t> m_row; // row converted to the file's channel order
+};
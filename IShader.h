@@ -12,6 +12,21 @@ public:
 	// vertex shader
 	virtual Vec4f vertex(int face_idx, int vert_idx) = 0;
 
-	// fragment shader
+	// fragment shader, bary_coords are perspective-correct
 	virtual bool fragment(const Vec3f& bary_coords, Color& out_color) = 0;
+
+	// shaders that pack their varyings as floats let the rasterizer interpolate them (see TriangleSetup.h),
+	// fragment_interpolated() is then called instead of fragment(). 0 = barycentric fragment() only
+	virtual int varying_count() const { return 0; }
+	virtual const float* varyings(int vert_idx) const { return nullptr; }
+	virtual bool fragment_interpolated(const float* varyings, Color& out_color) { return false; }
+
+	// called by the rasterizer when the color from the last fragment() call passed the depth test and was written,
+	// x/y are image pixel coordinates (relative to the region origin for strip images)
+	virtual void fragment_written(int x, int y, float depth) {}
+
+	// coarse shading reuses one fragment() result for a block of pixels. keep_fragment(slot) follows the block's
+	// fragment() call, reuse_fragment(slot) makes that call the "last" one again before its pixels are written
+	virtual void keep_fragment(int slot) {}
+	virtual void reuse_fragment(int slot) {}
 };
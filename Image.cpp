@@ -3,8 +3,10 @@
 #include <iostream>
 #include <algorithm> //std::swap
 #include <cmath> //std::abs
+#include "Profiler.h"
+#include "TriangleSetup.h"
 
-Image::Image(int width, int height) : m_width(width), m_height(height)
+Image::Image(int width, int height) : m_width(width), m_height(height), m_frame_width(width), m_frame_height(height)
 {
 	m_buffer.resize(m_width * m_height, black);
 	m_zbuffer.resize(m_width * m_height, std::numeric_limits<float>::infinity());
@@ -17,6 +19,7 @@ bool Image::set_pixel(int x, int y, float z, const Color& c)
 	int index = y * m_width + x;
 	if (z < m_zbuffer[index]) // pixel is closer
 	{
+		PROFILE_PIXEL(x + m_origin_x, y + m_origin_y); // frame coordinates, strips share one heatmap
 		m_zbuffer[index] = z;
 		m_buffer[index] = c;
 		return true;
@@ -25,6 +28,23 @@ bool Image::set_pixel(int x, int y, float z, const Color& c)
 	return false; // pixel was occluded
 }
 
+void Image::set_frame_region(int frame_width, int frame_height, int origin_x, int origin_y)
+{
+	m_frame_width = frame_width;
+	m_frame_height = frame_height;
+	m_origin_x = origin_x;
+	m_origin_y = origin_y;
+}
+
+void Image::write_pixel(int x, int y, float z, const Color& c)
+{
+	if (x < 0 || x >= m_width || y < 0 || y >= m_height) return;
+
+	int index = y * m_width + x;
+	m_zbuffer[index] = z;
+	m_buffer[index] = c;
+}
+
 // A Fast Voxel Traversal Algorithm for Ray Tracing
 // by John Amanatides and Andrew Woo, August 1987
 //void Image::drawLine(int x0, int y0, int x1, int y1, const Color& c)
@@ -68,49 +88,174 @@ bool Image::set_pixel(int x, int y, float z, const Color& c)
 //	}
 //}
 
-Vec3f barycentric(const Vec3f* pts, int x, int y)
+int Image::drawTriangle(Vec3f v_screen[3], IShader& shader)
 {
-	Vec3f u = Vec3f(pts[2].x - pts[0].x, pts[1].x - pts[0].x, pts[0].x - x).cross(
-		Vec3f(pts[2].y - pts[0].y, pts[1].y - pts[0].y, pts[0].y - y));
+	// bounding box, in frame coordinates clipped to this image's region
+	int min_x = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
+	int max_x = static_cast<int>(std::min((float)m_frame_width - 1, std::max({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
+	int min_y = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
+	int max_y = static_cast<int>(std::min((float)m_frame_height - 1, std::max({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
+	if (min_x > max_x || min_y > max_y)
+	{
+		PROFILE_COUNT(TrianglesOffscreen, 1);
+		return 0;
+	}
+	// a triangle drawn into several strip images is counted by the one holding its first row
+	const bool counts_triangle = min_y >= m_origin_y && min_y < m_origin_y + m_height;
+	min_x = std::max(min_x, m_origin_x);
+	max_x = std::min(max_x, m_origin_x + m_width - 1);
+	min_y = std::max(min_y, m_origin_y);
+	max_y = std::min(max_y, m_origin_y + m_height - 1);
+	if (min_x > max_x || min_y > max_y) return 0;
 
-	if (std::abs(u.z) < 1.0f) // triangle is degenerate
-		return { -1,-1,-1 };
+	// triangle setup, shaders without packed varyings get perspective-correct barycentrics interpolated as varyings
+	static const float bary_varyings[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	const bool packed = shader.varying_count() > 0;
+	const float* vertex_varyings[3];
+	for (int i = 0; i < 3; ++i) vertex_varyings[i] = packed ? shader.varyings(i) : bary_varyings[i];
 
-	float u_coord = 1.0f - (u.x + u.y) / u.z;
-	float v_coord = u.y / u.z;
-	float w_coord = u.x / u.z;
+	TriangleSetup setup;
+	if (!setup.setup(v_screen, vertex_varyings, packed ? shader.varying_count() : 3))
+	{
+		if (counts_triangle) PROFILE_COUNT(TrianglesDegenerate, 1);
+		return 0;
+	}
+	if (counts_triangle) PROFILE_COUNT(TrianglesRasterized, 1);
+	const int count = setup.varying_count;
 
-	return { u_coord, v_coord, w_coord };
-}
+	// per-triangle tallies, flushed to the profiler once at the end
+	int fragments_shaded = 0;
+	int fragments_rejected = 0;
+	PROFILE_SAMPLED_STAGE(Shade);
 
-void Image::drawTriangle(Vec3f v_screen[3], IShader& shader)
-{
-	// bounding box
-	int min_x = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
-	int max_x = static_cast<int>(std::min((float)m_width - 1, std::max({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
-	int min_y = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
-	int max_y = static_cast<int>(std::min((float)m_height - 1, std::max({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
+	// coarse shading reuses one shaded color per block. the first covered pixel that passes the depth test triggers it,
+	// the varyings come from the block center so the result doesnt depend on which pixel that was
+	bool coarse = m_shading_rate != ShadingRate::Rate1x1 || m_shading_rate_map;
+	if (coarse && m_block_ids.size() < static_cast<std::size_t>(m_width))
+	{
+		m_block_colors.resize(m_width);
+		m_block_ids.resize(m_width);
+		m_block_keep.resize(m_width);
+	}
+	if (coarse) std::fill(m_block_ids.begin(), m_block_ids.begin() + (max_x - min_x + 1), -1);
+	int last_slot = -1; // slot of the shader's last fragment() call
+
+	// perspective-correct varyings at the current pixel -> fragment shader
+	float span_varyings[max_varyings];
+	float block_varyings[max_varyings];
+	float pixel_varyings[max_varyings];
+	auto run_fragment = [&](const float* varyings_over_w, float w, Color& out_color)
+	{
+		for (int i = 0; i < count; ++i) pixel_varyings[i] = varyings_over_w[i] * w;
+
+		PROFILE_SAMPLE(Shade);
+		fragments_shaded++;
+		if (packed) return shader.fragment_interpolated(pixel_varyings, out_color);
+		return shader.fragment(Vec3f(pixel_varyings[0], pixel_varyings[1], pixel_varyings[2]), out_color);
+	};
 
 	for (int y = min_y; y <= max_y; y++)
 	{
-		for (int x = min_x; x <= max_x; x++)
+		const float fy = static_cast<float>(y);
+		const int local_y = y - m_origin_y;
+		float e0 = setup.edge[0].at(static_cast<float>(min_x), fy);
+		float e1 = setup.edge[1].at(static_cast<float>(min_x), fy);
+		float e2 = setup.edge[2].at(static_cast<float>(min_x), fy);
+		float span_inv_w = 0.0f;
+		bool in_span = false;
+
+		for (int x = min_x; x <= max_x; x++, e0 += setup.edge[0].a, e1 += setup.edge[1].a, e2 += setup.edge[2].a)
 		{
+			if (e0 < 0 || e1 < 0 || e2 < 0)
+			{
+				if (in_span) break; // triangles are convex, the row's span is over
+				continue;
+			}
+
+			// evaluate the planes where the span starts, then step them along it
+			if (!in_span)
+			{
+				in_span = true;
+				const float fx = static_cast<float>(x);
+				span_inv_w = setup.inv_w.at(fx, fy);
+				for (int i = 0; i < count; ++i) span_varyings[i] = setup.varyings[i].at(fx, fy);
+			}
+			else
+			{
+				span_inv_w += setup.inv_w.a;
+				for (int i = 0; i < count; ++i) span_varyings[i] += setup.varyings[i].a;
+			}
 
-			// barycentric coords
-			Vec3f bc_coords = barycentric(v_screen, x, y);
-			if (bc_coords.x < 0 || bc_coords.y < 0 || bc_coords.z < 0) continue;
+			// the one reciprocal per pixel, also the depth
+			float w = 1.0f / span_inv_w;
 
-			// interpolate depth
-			float w_interpolated = bc_coords.x * v_screen[0].z +
-				bc_coords.y * v_screen[1].z +
-				bc_coords.z * v_screen[2].z;
+			if (coarse)
+			{
+				// full-rate depth test first, hidden pixels never trigger shading
+				if (!(w < m_zbuffer[local_y * m_width + x - m_origin_x]))
+				{
+					fragments_rejected++;
+					continue;
+				}
 
-			// call fragment shader
+				int rate = static_cast<int>(m_shading_rate_map
+					? coarser(m_shading_rate, m_shading_rate_map->at_pixel(x, y)) : m_shading_rate);
+				// blocks are screen aligned, slot = block's first column inside the bounding box
+				int slot = std::max(x - x % rate, min_x) - min_x;
+				int block_id = (y / rate) * 8 + rate; // block row + rate, unique per slot
+				if (m_block_ids[slot] != block_id)
+				{
+					// block center, pulled onto the triangle when it's outside (small triangles would extrapolate far):
+					// negative barycentric weights clamped to 0, the rest rescaled
+					float cx = static_cast<float>(x - x % rate) + (rate - 1) * 0.5f;
+					float cy = static_cast<float>(y - y % rate) + (rate - 1) * 0.5f;
+					float b0 = setup.edge[0].at(cx, cy), b1 = setup.edge[1].at(cx, cy), b2 = setup.edge[2].at(cx, cy);
+					if (b0 < 0 || b1 < 0 || b2 < 0)
+					{
+						b0 = std::max(b0, 0.0f);
+						b1 = std::max(b1, 0.0f);
+						b2 = std::max(b2, 0.0f);
+						float inv_sum = 1.0f / (b0 + b1 + b2);
+						cx = (b0 * v_screen[0].x + b1 * v_screen[1].x + b2 * v_screen[2].x) * inv_sum;
+						cy = (b0 * v_screen[0].y + b1 * v_screen[1].y + b2 * v_screen[2].y) * inv_sum;
+					}
+					const float center_inv_w = setup.inv_w.at(cx, cy);
+					if (center_inv_w > 0.0f)
+					{
+						for (int i = 0; i < count; ++i) block_varyings[i] = setup.varyings[i].at(cx, cy);
+						m_block_keep[slot] = run_fragment(block_varyings, 1.0f / center_inv_w, m_block_colors[slot]);
+					}
+					else m_block_keep[slot] = run_fragment(span_varyings, w, m_block_colors[slot]); // extrapolated past the horizon
+
+					m_block_ids[slot] = block_id;
+					shader.keep_fragment(slot);
+					last_slot = slot;
+				}
+
+				if (m_block_keep[slot] && set_pixel(x - m_origin_x, local_y, w, m_block_colors[slot]))
+				{
+					// the pixel's color came from its block's call, not necessarily the latest one
+					if (slot != last_slot)
+					{
+						shader.reuse_fragment(slot);
+						last_slot = slot;
+					}
+					shader.fragment_written(x - m_origin_x, local_y, w);
+				}
+				continue;
+			}
+
+			// call fragment shader, draw pixel if it returns true
 			Color final_color;
-			// draw pixel if fragment shader returns true
-			if (shader.fragment(bc_coords, final_color)) set_pixel(x, y, w_interpolated, final_color);
+			if (!run_fragment(span_varyings, w, final_color)) continue;
+			if (set_pixel(x - m_origin_x, local_y, w, final_color)) shader.fragment_written(x - m_origin_x, local_y, w);
+			else fragments_rejected++;
 		}
 	}
+
+	PROFILE_COUNT(FragmentsShaded, fragments_shaded);
+	PROFILE_COUNT(FragmentsDepthRejected, fragments_rejected);
+	return fragments_shaded;
 }
 
 void Image::clear_buffers()
@@ -121,6 +266,12 @@ void Image::clear_buffers()
 
 bool Image::write_tga_file(const std::string& filename, bool v_flip)
 {
+	if (m_width > 65535 || m_height > 65535)
+	{
+		std::cerr << "error: " << m_width << "x" << m_height << " is too big for tga (max 65535), use FrameWriter with a .ppm file" << std::endl;
+		return false;
+	}
+
 	std::ofstream out(filename, std::ios::binary);
 	if (!out)
 	{
@@ -6,30 +6,58 @@
 #include "Vec.h"
 #include "Texture.h"
 #include "IShader.h"
+#include "ShadingRate.h"
 
 class Image {
 public:
 	Image(int width, int height);  // const, blank img
 	// single pixel color setter
 	bool set_pixel(int x, int y, float z, const Color& c);
+	// overwrite color and depth, no depth test
+	void write_pixel(int x, int y, float z, const Color& c);
 	// draw line, bresenham's algo
 	// void drawLine(int x0, int y0, int x1, int y1, const Color& c);
-	// draw a filled triangle
-	void drawTriangle(Vec3f v_screen[3], IShader& shader);
+	// draw a filled triangle, returns the number of fragments shaded
+	int drawTriangle(Vec3f v_screen[3], IShader& shader);
 	// clear color and depth buffers
 	void clear_buffers();
-	// wrt img to .tga file
+	// coarse shading for the following draws, the coarser of the per-draw rate and the map's tile rate wins
+	void set_shading_rate(ShadingRate rate) { m_shading_rate = rate; }
+	void set_shading_rate_map(const ShadingRateMap* rate_map) { m_shading_rate_map = rate_map; }
+	// make this image the width x height region at (origin_x, origin_y) of a larger frame, for strip rendering.
+	// drawTriangle takes frame coordinates and only touches the region, set_pixel/write_pixel stay image-local
+	void set_frame_region(int frame_width, int frame_height, int origin_x, int origin_y);
+	// wrt img to .tga file, up to 65535 x 65535 (16-bit header fields)
 	bool write_tga_file(const std::string& filename, bool v_flip = false);
 
 
 	// getters
 	int get_width() const { return m_width; }
 	int get_height() const { return m_height; }
+	// size of the whole frame the viewport transform maps to, same as the image unless it's a region
+	int get_frame_width() const { return m_frame_width; }
+	int get_frame_height() const { return m_frame_height; }
+	int get_origin_x() const { return m_origin_x; }
+	int get_origin_y() const { return m_origin_y; }
+	ShadingRate get_shading_rate() const { return m_shading_rate; }
+	const ShadingRateMap* get_shading_rate_map() const { return m_shading_rate_map; }
+	const std::vector<Color>& get_buffer() const { return m_buffer; }
 
 
 private:
 	int m_width;
 	int m_height;
+	int m_frame_width;
+	int m_frame_height;
+	int m_origin_x = 0;
+	int m_origin_y = 0;
 	std::vector<Color> m_buffer; // vector of pixel data
 	std::vector<float> m_zbuffer; // depth buffer for z-buffering
+
+	ShadingRate m_shading_rate = ShadingRate::Rate1x1;
+	const ShadingRateMap* m_shading_rate_map = nullptr;
+	// coarse shading scratch, one entry per block column of the current triangle's bounding box
+	std::vector<Color> m_block_colors;
+	std::vector<int> m_block_ids;
+	std::vector<std::uint8_t> m_block_keep;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Model.h"
+#include <algorithm> //std::min, std::max
 
 Model::Model(const std::string& filename)
 {
@@ -77,3 +78,82 @@ FaceIndex Model::parse_face_index(const std::string& token)
 
 	return idx;
 }
+
+std::size_t Model::vertex_memory_size() const
+{
+	return vertices.size() * sizeof(Vec3f) + uvs.size() * sizeof(Vec2f) + normals.size() * sizeof(Vec3f)
+		+ quantized_vertices.size() * sizeof(QuantizedPosition) + quantized_uvs.size() * sizeof(QuantizedUV)
+		+ quantized_normals.size() * sizeof(std::uint32_t);
+}
+
+void Model::quantize()
+{
+	if (is_quantized() || vertices.empty()) return;
+	std::size_t float_size = vertex_memory_size();
+
+	// bounding boxes
+	Vec3f max_pos = vertices[0];
+	position_min = vertices[0];
+	for (const Vec3f& v : vertices)
+	{
+		position_min = { std::min(position_min.x, v.x), std::min(position_min.y, v.y), std::min(position_min.z, v.z) };
+		max_pos = { std::max(max_pos.x, v.x), std::max(max_pos.y, v.y), std::max(max_pos.z, v.z) };
+	}
+	Vec3f extent = max_pos - position_min;
+	position_scale = extent * (1.0f / 65535.0f);
+
+	Vec2f max_uv = uvs.empty() ? Vec2f() : uvs[0];
+	uv_min = max_uv;
+	for (const Vec2f& uv : uvs)
+	{
+		uv_min = { std::min(uv_min.x, uv.x), std::min(uv_min.y, uv.y) };
+		max_uv = { std::max(max_uv.x, uv.x), std::max(max_uv.y, uv.y) };
+	}
+	Vec2f uv_extent = { max_uv.x - uv_min.x, max_uv.y - uv_min.y };
+	uv_scale = uv_extent * (1.0f / 65535.0f);
+
+	// encode, measuring the round trip error
+	float position_error = 0;
+	quantized_vertices.reserve(vertices.size());
+	for (const Vec3f& v : vertices)
+	{
+		QuantizedPosition q = {
+			quantize_unorm16(v.x, position_min.x, extent.x),
+			quantize_unorm16(v.y, position_min.y, extent.y),
+			quantize_unorm16(v.z, position_min.z, extent.z) };
+		quantized_vertices.push_back(q);
+		position_error = std::max(position_error, (dequantize_position(q, position_min, position_scale) - v).length());
+	}
+
+	float uv_error = 0;
+	quantized_uvs.reserve(uvs.size());
+	for (const Vec2f& uv : uvs)
+	{
+		QuantizedUV q = { quantize_unorm16(uv.x, uv_min.x, uv_extent.x), quantize_unorm16(uv.y, uv_min.y, uv_extent.y) };
+		quantized_uvs.push_back(q);
+		Vec2f decoded = dequantize_uv(q, uv_min, uv_scale);
+		uv_error = std::max({ uv_error, std::abs(decoded.x - uv.x), std::abs(decoded.y - uv.y) });
+	}
+
+	// angle from atan2(|a x b|, a . b), acos of a dot product this close to 1 is all float rounding
+	float normal_error = 0;
+	quantized_normals.reserve(normals.size());
+	for (const Vec3f& n : normals)
+	{
+		std::uint32_t q = encode_octahedral(n);
+		quantized_normals.push_back(q);
+		Vec3f decoded = decode_octahedral(q).normalize();
+		normal_error = std::max(normal_error, std::atan2(decoded.cross(n).length(), decoded.dot(n)));
+	}
+
+	std::vector<Vec3f>().swap(vertices);
+	std::vector<Vec2f>().swap(uvs);
+	std::vector<Vec3f>().swap(normals);
+
+	float diagonal = extent.length();
+	float normal_degrees = normal_error * 180.0f / 3.14159265f;
+	std::cout << "model quantized: " << float_size / 1024 << " KiB -> " << vertex_memory_size() / 1024 << " KiB"
+		<< " (" << static_cast<double>(float_size) / vertex_memory_size() << "x smaller)"
+		<< " | max error: position " << position_error << " (" << (diagonal > 0 ? position_error / diagonal * 100.0f : 0.0f) << "% of bbox)"
+		<< ", uv " << uv_error << ", normal " << normal_degrees << " deg" << std::endl;
+}
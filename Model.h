@@ -5,6 +5,7 @@
 #include <sstream>
 #include <iostream>
 #include "Vec.h"
+#include "VertexQuantization.h"
 
 struct FaceIndex {
 	int v_idx = -1; // vertex index
@@ -19,9 +20,24 @@ public:
 	std::vector<Vec3f> normals; // list of normals
 	std::vector<std::vector<FaceIndex>> faces; // list of faces (each face is a list of vertex indices)
 
+	// compact vertex layout (see VertexQuantization.h), filled by quantize(), same indices as the float lists
+	std::vector<QuantizedPosition> quantized_vertices;
+	std::vector<QuantizedUV> quantized_uvs;
+	std::vector<std::uint32_t> quantized_normals;
+	Vec3f position_min; // bounding box min
+	Vec3f position_scale; // bounding box extent / 65535
+	Vec2f uv_min;
+	Vec2f uv_scale;
+
 	Model() = default; // def constructor
 	Model(const std::string& filename);
 
-private:
-	FaceIndex parse_face_index(const std::string& token);
+	// switch to the compact layout and free the float lists, prints the memory saved and the worst quantization error
+	void quantize();
+	bool is_quantized() const { return !quantized_vertices.empty(); }
+	// bytes of vertex attribute data in the active layout
+	std::size_t vertex_memory_size() const;
+
+	// "v/vt/vn" token of an OBJ face line, 0-based, missing parts stay -1
+	static FaceIndex parse_face_index(const std::string& token);
 };
\ No newline at end of file
@@ -1,12 +1,26 @@
 #include "PhongShader.h"
+#include "SurfaceCache.h"
 
 Vec4f PhongShader::vertex(int face_idx, int vert_idx)
 {
 	// get the vertex index from the face
 	const FaceIndex& face = model->faces[face_idx][vert_idx];
-	Vec3f v_world = model->vertices[face.v_idx];
-	Vec2f uv = model->uvs[face.vt_idx];
-	Vec3f normal = model->normals[face.vn_idx];
+	Vec3f v_world;
+	Vec2f uv;
+	Vec3f normal;
+	if (model->is_quantized())
+	{
+		// decode the compact layout
+		v_world = dequantize_position(model->quantized_vertices[face.v_idx], model->position_min, model->position_scale);
+		uv = dequantize_uv(model->quantized_uvs[face.vt_idx], model->uv_min, model->uv_scale);
+		normal = decode_octahedral(model->quantized_normals[face.vn_idx]); // normalized after the model matrix below
+	}
+	else
+	{
+		v_world = model->vertices[face.v_idx];
+		uv = model->uvs[face.vt_idx];
+		normal = model->normals[face.vn_idx];
+	}
 
 	// transform
 	// world coords, for lighting
@@ -16,9 +30,17 @@ Vec4f PhongShader::vertex(int face_idx, int vert_idx)
 	Vec4f clip_pos = uniform_mvp * Vec4f(v_world, 1.0f);
 
 	// store varying data for vertex
-	varying_world_coords[vert_idx] = world_pos.to_vec3f();
-	varying_uvs[vert_idx] = uv;
-	varying_normals[vert_idx] = (uniform_model_matrix * Vec4f(normal, .0f)).to_vec3f().normalize();
+	Vec3f world = world_pos.to_vec3f();
+	Vec3f world_normal = (uniform_model_matrix * Vec4f(normal, .0f)).to_vec3f().normalize();
+	float* out = varying_data[vert_idx];
+	out[uv_u] = uv.x;
+	out[uv_v] = uv.y;
+	out[normal_x] = world_normal.x;
+	out[normal_y] = world_normal.y;
+	out[normal_z] = world_normal.z;
+	out[world_x] = world.x;
+	out[world_y] = world.y;
+	out[world_z] = world.z;
 
 	return clip_pos;
 }
@@ -26,43 +48,73 @@ Vec4f PhongShader::vertex(int face_idx, int vert_idx)
 bool PhongShader::fragment(const Vec3f& bary_coords, Color& out_color)
 {
 	// interpolate varying data using barycentric coordinates
-    Vec2f uv = varying_uvs[0] * bary_coords.x +
-        varying_uvs[1] * bary_coords.y +
-        varying_uvs[2] * bary_coords.z;
-
-    Vec3f normal = (varying_normals[0] * bary_coords.x +
-        varying_normals[1] * bary_coords.y +
-        varying_normals[2] * bary_coords.z).normalize();
+	float interpolated[varying_total];
+	for (int i = 0; i < varying_total; ++i)
+	{
+		interpolated[i] = varying_data[0][i] * bary_coords.x +
+			varying_data[1][i] * bary_coords.y +
+			varying_data[2][i] * bary_coords.z;
+	}
+
+	return fragment_interpolated(interpolated, out_color);
+}
 
-    Vec3f world_pos = varying_world_coords[0] * bary_coords.x +
-        varying_world_coords[1] * bary_coords.y +
-        varying_world_coords[2] * bary_coords.z;
+bool PhongShader::fragment_interpolated(const float* varyings, Color& out_color)
+{
+	Vec2f uv = { varyings[uv_u], varyings[uv_v] };
+	Vec3f normal = Vec3f(varyings[normal_x], varyings[normal_y], varyings[normal_z]).normalize();
+	Vec3f world_pos = { varyings[world_x], varyings[world_y], varyings[world_z] };
 
 	// sample texture color
     Color texture_color = texture->sample(uv.x, uv.y);
 
-	// Blinn-Phong lighting model
+    if (surface_cache)
+    {
+        m_last.world_pos = world_pos;
+        m_last.normal = normal;
+        m_last.texture_color = texture_color;
+    }
 
-	// light properties
-    float ambient_strength = 0.2f;
-    float diffuse_strength = 0.8f;
-    float specular_strength = 1.0f;
-    float shininess = 32.0f;
-	Vec3f light_color = { 1.0f, 1.0f, 1.0f }; // white light
+    out_color = shade(world_pos, normal, texture_color);
+    return true; // true = draw this pixel
+}
+
+void PhongShader::fragment_written(int x, int y, float depth)
+{
+    if (!surface_cache) return;
+    m_last.depth = depth;
+    surface_cache->store(x, y, m_last);
+}
+
+void PhongShader::keep_fragment(int slot)
+{
+    if (!surface_cache) return;
+    if (slot >= static_cast<int>(m_kept.size())) m_kept.resize(slot + 1);
+    m_kept[slot] = m_last;
+}
+
+void PhongShader::reuse_fragment(int slot)
+{
+    if (surface_cache) m_last = m_kept[slot];
+}
+
+Color PhongShader::shade(const Vec3f& world_pos, const Vec3f& normal, const Color& texture_color) const
+{
+	// Blinn-Phong lighting model
 
     // ambient
-    Vec3f ambient = light_color * ambient_strength;
+    Vec3f ambient = uniform_light_color * uniform_ambient_strength;
 
     // diffuse
     Vec3f light_dir = (uniform_light_pos - world_pos).normalize();
     float diff = std::max(0.0f, normal.dot(light_dir));
-    Vec3f diffuse = light_color * diff * diffuse_strength;
+    Vec3f diffuse = uniform_light_color * diff * uniform_diffuse_strength;
 
     // specular
     Vec3f view_dir = (uniform_camera_pos - world_pos).normalize();
     Vec3f half_dir = (light_dir + view_dir).normalize();
-    float spec = std::pow(std::max(0.0f, normal.dot(half_dir)), shininess);
-    Vec3f specular = light_color * spec * specular_strength;
+    float spec = std::pow(std::max(0.0f, normal.dot(half_dir)), uniform_shininess);
+    Vec3f specular = uniform_light_color * spec * uniform_specular_strength;
 
 	// combine results
     Vec3f base_color = { texture_color.r / 255.f, texture_color.g / 255.f, texture_color.b / 255.f };
@@ -74,12 +126,9 @@ bool PhongShader::fragment(const Vec3f& bary_coords, Color& out_color)
     final_rgb.z = std::min(1.0f, final_rgb.z);
 
 	// convert to Color
-    out_color = Color(
+    return Color(
         static_cast<std::uint8_t>(final_rgb.x * 255),
         static_cast<std::uint8_t>(final_rgb.y * 255),
         static_cast<std::uint8_t>(final_rgb.z * 255)
     );
-
-    return true; // true = draw this pixel
 }
-
@@ -1,12 +1,15 @@
 #pragma once
+#include <vector>
 #include "IShader.h"
+#include "SurfaceCache.h"
+#include "TriangleSetup.h"
 
 class PhongShader : public IShader {
 public:
-	// data from vertex shader to fragment shader
-	Vec2f varying_uvs[3];
-	Vec3f varying_normals[3];
-	Vec3f varying_world_coords[3];
+	// data from vertex shader to fragment shader, packed per vertex for the rasterizer's triangle setup
+	enum Varying { uv_u, uv_v, normal_x, normal_y, normal_z, world_x, world_y, world_z, varying_total };
+	float varying_data[3][varying_total];
+	static_assert(varying_total <= max_varyings, "more varyings than the rasterizer's triangle setup holds");
 
 	// uniforms
 	const Model* model = nullptr;
@@ -16,9 +19,35 @@ public:
 	Vec3f uniform_light_pos;
 	Vec3f uniform_camera_pos;
 
+	// light / material, shading-only inputs (a SurfaceCache stays valid when only these change)
+	Vec3f uniform_light_color = { 1.0f, 1.0f, 1.0f }; // white light
+	float uniform_ambient_strength = 0.2f;
+	float uniform_diffuse_strength = 0.8f;
+	float uniform_specular_strength = 1.0f;
+	float uniform_shininess = 32.0f;
+
+	// when set, every written fragment's surface is recorded for relighting
+	SurfaceCache* surface_cache = nullptr;
+
 	// vertex shader
 	virtual Vec4f vertex(int face_idx, int vert_idx) override;
 
 	// fragment shader
 	virtual bool fragment(const Vec3f& bary_coords, Color& out_color) override;
+	virtual void fragment_written(int x, int y, float depth) override;
+	virtual void keep_fragment(int slot) override;
+	virtual void reuse_fragment(int slot) override;
+
+	virtual int varying_count() const override { return varying_total; }
+	virtual const float* varyings(int vert_idx) const override { return varying_data[vert_idx]; }
+	virtual bool fragment_interpolated(const float* varyings, Color& out_color) override;
+
+	// blinn-phong lighting for an already interpolated surface point, no per-triangle state
+	Color shade(const Vec3f& world_pos, const Vec3f& normal, const Color& texture_color) const;
+
+private:
+	// surface of the last fragment() call, stored into surface_cache once it is written
+	Surface m_last;
+	// coarse shading blocks' surfaces, by slot
+	std::vector<Surface> m_kept;
 };
\ No newline at end of file
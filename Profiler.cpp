@@ -0,0 +1,202 @@
+#include "Profiler.h"
+
+#ifdef RASTER_PROFILE
+#include <fstream>
+#include <iostream>
+#include <algorithm> //std::max
+#include "Image.h"
+
+static const char* stage_names[] = { "vertex", "cull", "raster", "shade" };
+static const char* counter_names[] = {
+	"triangles_in", "triangles_culled", "triangles_offscreen", "triangles_degenerate", "triangles_rasterized",
+	"fragments_shaded", "fragments_depth_rejected", "overdraw"
+};
+
+// small sequential ids read better in the trace viewer than hashed std::thread::id
+static int current_tid()
+{
+	static std::atomic<int> next_tid{ 1 };
+	thread_local int tid = next_tid++;
+	return tid;
+}
+
+Profiler& Profiler::instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler() : m_epoch_ns(now_ns())
+{
+	for (auto& c : m_counters) c = 0;
+	for (auto& s : m_stage_ns) s = 0;
+}
+
+std::uint64_t Profiler::now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::uint64_t Profiler::clock_overhead_ns()
+{
+	static const std::uint64_t overhead = []
+	{
+		// fastest of many pairs, the rest were interrupted
+		std::uint64_t best = ~0ull;
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::uint64_t start = now_ns();
+			best = std::min(best, now_ns() - start);
+		}
+		return best;
+	}();
+	return overhead;
+}
+
+void Profiler::begin_frame(int width, int height)
+{
+	for (auto& c : m_counters) c = 0;
+	for (auto& s : m_stage_ns) s = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_events_mutex);
+		m_events.clear();
+	}
+
+	m_width = width;
+	m_height = height;
+	std::size_t pixels = static_cast<std::size_t>(width) * height;
+	if (pixels > max_heatmap_pixels)
+	{
+		std::cerr << "profiler: " << width << "x" << height << " frame, no overdraw heatmap" << std::endl;
+		m_heatmap.reset();
+	}
+	else
+	{
+		m_heatmap.reset(new std::atomic<std::uint32_t>[pixels]);
+		for (std::size_t i = 0; i < pixels; ++i) m_heatmap[i] = 0;
+	}
+
+	m_frame_start_ns = now_ns();
+}
+
+void Profiler::add_event(const char* name, std::uint64_t start_ns, std::uint64_t end_ns)
+{
+	std::lock_guard<std::mutex> lock(m_events_mutex);
+	m_events.push_back({ name, start_ns, end_ns, current_tid() });
+}
+
+void Profiler::pixel_written(int x, int y)
+{
+	if (!m_heatmap || x < 0 || x >= m_width || y < 0 || y >= m_height) return;
+
+	// first write is coverage, every write after that is overdraw
+	if (m_heatmap[y * m_width + x]++ > 0) count(Counter::Overdraw);
+}
+
+bool Profiler::write_chrome_trace(const std::string& filename) const
+{
+	std::ofstream out(filename);
+	if (!out)
+	{
+		std::cerr << "error: cant open file " << filename << " to write" << std::endl;
+		return false;
+	}
+
+	// trace timestamps are in microseconds
+	auto us = [this](std::uint64_t ns) { return (ns - m_epoch_ns) / 1000.0; };
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"pipeline stages (accumulated)\"}}";
+
+	{
+		std::lock_guard<std::mutex> lock(m_events_mutex);
+		for (const auto& e : m_events)
+		{
+			out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+				<< ",\"ts\":" << us(e.start_ns) << ",\"dur\":" << (e.end_ns - e.start_ns) / 1000.0 << "}";
+		}
+	}
+
+	// per-triangle stages are interleaved, lay their totals out back to back on their own track
+	std::uint64_t shade_ns = get_stage_ns(Stage::Shade);
+	std::uint64_t t = m_frame_start_ns;
+	for (int s = 0; s < static_cast<int>(Stage::Count); ++s)
+	{
+		std::uint64_t dur = m_stage_ns[s];
+		if (static_cast<Stage>(s) == Stage::Raster) dur = dur > shade_ns ? dur - shade_ns : 0; // self time
+		out << ",\n{\"name\":\"" << stage_names[s] << "\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+			<< ",\"ts\":" << us(t) << ",\"dur\":" << dur / 1000.0 << "}";
+		t += dur;
+	}
+
+	out << ",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << us(t) << ",\"args\":{";
+	for (int c = 0; c < static_cast<int>(Counter::Count); ++c)
+	{
+		if (c > 0) out << ",";
+		out << "\"" << counter_names[c] << "\":" << m_counters[c];
+	}
+	out << "}}\n]}\n";
+
+	out.close();
+	if (!out)
+	{
+		std::cerr << "error: something bad happened while writing " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "trace saved to " << filename << std::endl;
+	return true;
+}
+
+bool Profiler::write_overdraw_heatmap(const std::string& filename) const
+{
+	if (!m_heatmap) return false;
+
+	std::uint32_t max_writes = 1;
+	for (int i = 0; i < m_width * m_height; ++i) max_writes = std::max<std::uint32_t>(max_writes, m_heatmap[i]);
+
+	Image heatmap(m_width, m_height);
+	for (int y = 0; y < m_height; ++y)
+	{
+		for (int x = 0; x < m_width; ++x)
+		{
+			std::uint32_t writes = m_heatmap[y * m_width + x];
+			if (writes == 0) continue; // leave untouched pixels black
+
+			// black -> blue -> red -> yellow -> white
+			float t = static_cast<float>(writes) / max_writes;
+			auto ramp = [](float f) { return std::min(1.0f, std::max(0.0f, f)); };
+			float r = ramp((t - 0.25f) * 4.0f);
+			float g = ramp((t - 0.5f) * 4.0f);
+			float b = t < 0.25f ? t * 4.0f : (t < 0.5f ? 1.0f - (t - 0.25f) * 4.0f : ramp((t - 0.75f) * 4.0f));
+			// write_pixel, set_pixel would count the heatmap's own writes into it
+			heatmap.write_pixel(x, y, 0.0f, Color(
+				static_cast<std::uint8_t>(r * 255),
+				static_cast<std::uint8_t>(g * 255),
+				static_cast<std::uint8_t>(b * 255)));
+		}
+	}
+
+	if (!heatmap.write_tga_file(filename)) return false;
+	std::cout << "overdraw heatmap saved to " << filename << " | max writes per pixel: " << max_writes << std::endl;
+	return true;
+}
+
+void Profiler::print_summary() const
+{
+	std::uint64_t shade_ns = get_stage_ns(Stage::Shade);
+	std::uint64_t raster_ns = get_stage_ns(Stage::Raster);
+
+	std::cout << "profile | vertex: " << get_stage_ns(Stage::Vertex) / 1e6 << " ms"
+		<< " | cull: " << get_stage_ns(Stage::Cull) / 1e6 << " ms"
+		<< " | raster: " << (raster_ns > shade_ns ? raster_ns - shade_ns : 0) / 1e6 << " ms"
+		<< " | shade: " << shade_ns / 1e6 << " ms" << std::endl;
+
+	std::cout << "profile";
+	for (int c = 0; c < static_cast<int>(Counter::Count); ++c)
+		std::cout << " | " << counter_names[c] << ": " << m_counters[c];
+	std::cout << std::endl;
+}
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+// pipeline profiler: scoped timers, per-stage time totals and atomic counters
+// build with RASTER_PROFILE defined to enable it, otherwise every PROFILE_* macro compiles to nothing
+
+#ifdef RASTER_PROFILE
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// stages that run interleaved per triangle, their time is accumulated instead of traced one by one
+enum class Stage {
+	Vertex,
+	Cull,
+	Raster, // includes shading, self time is raster - shade
+	Shade,
+	Count
+};
+
+enum class Counter {
+	TrianglesIn,
+	TrianglesCulled,
+	TrianglesOffscreen, // front facing, bounding box outside the frame
+	TrianglesDegenerate, // dropped by triangle setup, less than half a pixel of area
+	TrianglesRasterized, // in = culled + offscreen + degenerate + rasterized
+	FragmentsShaded,
+	FragmentsDepthRejected,
+	Overdraw, // color writes to a pixel that was already written this frame
+	Count
+};
+
+class Profiler {
+public:
+	static Profiler& instance();
+
+	// no heatmap (and no overdraw count) for frames over this, poster sized frames would need gigabytes
+	static const std::size_t max_heatmap_pixels = 8192 * 8192;
+
+	// reset counters, stage totals, trace events and the overdraw heatmap for a new frame
+	void begin_frame(int width, int height);
+
+	// complete ("X") trace event, timestamps in ns from now_ns()
+	void add_event(const char* name, std::uint64_t start_ns, std::uint64_t end_ns);
+	void add_stage_time(Stage stage, std::uint64_t ns) { m_stage_ns[static_cast<int>(stage)] += ns; }
+	void count(Counter counter, std::uint64_t n = 1) { m_counters[static_cast<int>(counter)] += n; }
+	void pixel_written(int x, int y);
+
+	std::uint64_t get_counter(Counter counter) const { return m_counters[static_cast<int>(counter)]; }
+	std::uint64_t get_stage_ns(Stage stage) const { return m_stage_ns[static_cast<int>(stage)]; }
+
+	// chrome://tracing / perfetto compatible json
+	bool write_chrome_trace(const std::string& filename) const;
+	// per-pixel write count as a black-blue-red-yellow-white ramp
+	bool write_overdraw_heatmap(const std::string& filename) const;
+	void print_summary() const;
+
+	static std::uint64_t now_ns();
+	// what a back-to-back now_ns() pair measures with nothing between, measured once
+	static std::uint64_t clock_overhead_ns();
+
+private:
+	struct Event {
+		const char* name;
+		std::uint64_t start_ns;
+		std::uint64_t end_ns;
+		int tid;
+	};
+
+	Profiler();
+
+	std::uint64_t m_epoch_ns;
+	std::uint64_t m_frame_start_ns = 0;
+	std::atomic<std::uint64_t> m_counters[static_cast<int>(Counter::Count)];
+	std::atomic<std::uint64_t> m_stage_ns[static_cast<int>(Stage::Count)];
+
+	mutable std::mutex m_events_mutex;
+	std::vector<Event> m_events;
+
+	int m_width = 0;
+	int m_height = 0;
+	std::unique_ptr<std::atomic<std::uint32_t>[]> m_heatmap;
+};
+
+// traces a named block as one event
+class ScopedEvent {
+public:
+	explicit ScopedEvent(const char* name) : m_name(name), m_start(Profiler::now_ns()) {}
+	~ScopedEvent() { Profiler::instance().add_event(m_name, m_start, Profiler::now_ns()); }
+private:
+	const char* m_name;
+	std::uint64_t m_start;
+};
+
+// adds the block's duration to a stage total
+class ScopedStage {
+public:
+	explicit ScopedStage(Stage stage) : m_stage(stage), m_start(Profiler::now_ns()) {}
+	~ScopedStage() { Profiler::instance().add_stage_time(m_stage, Profiler::now_ns() - m_start); }
+private:
+	Stage m_stage;
+	std::uint64_t m_start;
+};
+
+// stage total for blocks too short to afford two clock reads each (one fragment's shading).
+// only every sample_interval-th block on the thread is timed, counted sample_interval times,
+// and the sum goes to the profiler once when this goes out of scope
+class SampledStage {
+public:
+	static const std::uint32_t sample_interval = 16;
+
+	explicit SampledStage(Stage stage) : m_stage(stage) {}
+	~SampledStage() { if (m_sampled_ns > 0) Profiler::instance().add_stage_time(m_stage, m_sampled_ns * sample_interval); }
+
+	// times one block if its turn comes up
+	class Sample {
+	public:
+		explicit Sample(SampledStage& owner) : m_owner(owner), m_start(next_tick() % sample_interval == 0 ? Profiler::now_ns() : 0) {}
+		~Sample()
+		{
+			if (!m_start) return;
+			// the clock read is a good share of one fragment, leave it out
+			std::uint64_t ns = Profiler::now_ns() - m_start;
+			std::uint64_t overhead = Profiler::clock_overhead_ns();
+			m_owner.m_sampled_ns += ns > overhead ? ns - overhead : 0;
+		}
+	private:
+		static std::uint32_t next_tick()
+		{
+			thread_local std::uint32_t tick = 0;
+			return tick++;
+		}
+		SampledStage& m_owner;
+		std::uint64_t m_start;
+	};
+
+private:
+	Stage m_stage;
+	std::uint64_t m_sampled_ns = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedEvent PROFILE_CONCAT(profile_event_, __LINE__)(name)
+#define PROFILE_STAGE(stage) ScopedStage PROFILE_CONCAT(profile_stage_, __LINE__)(Stage::stage)
+// declares the accumulator, PROFILE_SAMPLE inside the short block (may be in a lambda) times it
+#define PROFILE_SAMPLED_STAGE(stage) SampledStage profile_sampled_##stage(Stage::stage)
+#define PROFILE_SAMPLE(stage) SampledStage::Sample PROFILE_CONCAT(profile_sample_, __LINE__)(profile_sampled_##stage)
+#define PROFILE_COUNT(counter, n) Profiler::instance().count(Counter::counter, (n))
+#define PROFILE_PIXEL(x, y) Profiler::instance().pixel_written((x), (y))
+#define PROFILE_BEGIN_FRAME(width, height) Profiler::instance().begin_frame((width), (height))
+#define PROFILE_REPORT(trace_file, heatmap_file) \
+	do { \
+		Profiler::instance().print_summary(); \
+		Profiler::instance().write_chrome_trace(trace_file); \
+		Profiler::instance().write_overdraw_heatmap(heatmap_file); \
+	} while (0)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_STAGE(stage)
+#define PROFILE_SAMPLED_STAGE(stage)
+#define PROFILE_SAMPLE(stage)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#define PROFILE_PIXEL(x, y) ((void)0)
+#define PROFILE_BEGIN_FRAME(width, height) ((void)0)
+#define PROFILE_REPORT(trace_file, heatmap_file) ((void)0)
+
+#endif
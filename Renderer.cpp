@@ -0,0 +1,224 @@
+#include "Renderer.h"
+#include "Profiler.h"
+#include <thread>
+#include <algorithm> //std::min, std::max
+#include "FrameWriter.h"
+
+// vertex shader + viewport transform, w is kept in z for depth
+static void project_face(IShader& shader, int face, int frame_width, int frame_height, Vec3f v_screen[3])
+{
+	// run vertex shader for each vertex of the triangle
+	Vec4f clip_coords[3];
+	for (int j = 0; j < 3; ++j) clip_coords[j] = shader.vertex(face, j);
+
+	// project to screen space
+	for (int j = 0; j < 3; ++j)
+	{
+		Vec3f ndc = clip_coords[j].to_vec3f();
+		float screen_x = (ndc.x + 1.0f) * 0.5f * frame_width;
+		float screen_y = (1.0f - ndc.y) * 0.5f * frame_height; // flip Y
+		v_screen[j] = { screen_x, screen_y, clip_coords[j].w }; // store w for depth
+	}
+}
+
+static bool is_back_facing(const Vec3f v_screen[3])
+{
+	Vec3f v0_screen = { v_screen[0].x, v_screen[0].y, 0 };
+	Vec3f v1_screen = { v_screen[1].x, v_screen[1].y, 0 };
+	Vec3f v2_screen = { v_screen[2].x, v_screen[2].y, 0 };
+	Vec3f normal_screen = (v1_screen - v0_screen).cross(v2_screen - v0_screen).normalize();
+	return normal_screen.z < 0;
+}
+
+static void render_face(Image& image, IShader& shader, int face, RenderStats& stats)
+{
+	PROFILE_COUNT(TrianglesIn, 1);
+	stats.triangles_in++;
+
+	Vec3f v_screen[3];
+	{
+		PROFILE_STAGE(Vertex);
+		project_face(shader, face, image.get_frame_width(), image.get_frame_height(), v_screen);
+	}
+
+	// back-face culling
+	bool culled;
+	{
+		PROFILE_STAGE(Cull);
+		culled = is_back_facing(v_screen);
+	}
+
+	if (culled)
+	{
+		PROFILE_COUNT(TrianglesCulled, 1);
+		stats.triangles_culled++;
+		return;
+	}
+
+	// draw triangle
+	PROFILE_STAGE(Raster);
+	stats.triangles_rasterized++;
+	stats.fragments_shaded += image.drawTriangle(v_screen, shader);
+}
+
+// a face the strip pre-pass already counted and found front facing, drawn into one strip.
+// the vertex shader reruns (the shader's varyings belong to the last face), nothing is counted again
+static void draw_binned_face(Image& strip, IShader& shader, int face, RenderStats& stats)
+{
+	Vec3f v_screen[3];
+	{
+		PROFILE_STAGE(Vertex);
+		project_face(shader, face, strip.get_frame_width(), strip.get_frame_height(), v_screen);
+	}
+
+	PROFILE_STAGE(Raster);
+	stats.fragments_shaded += strip.drawTriangle(v_screen, shader);
+}
+
+RenderStats render_model(Image& image, const Model& model, IShader& shader)
+{
+	RenderStats stats;
+	for (int i = 0; i < static_cast<int>(model.faces.size()); ++i)
+	{
+		if (model.faces[i].size() != 3) continue;
+		render_face(image, shader, i, stats);
+	}
+	return stats;
+}
+
+bool render_model_strips(const Model& model, IShader& shader, int width, int height, int strip_rows, const std::string& filename,
+	RenderStats& stats)
+{
+	stats = RenderStats();
+	strip_rows = std::max(1, std::min(strip_rows, height));
+	const int strip_count = (height + strip_rows - 1) / strip_rows;
+
+	FrameWriter writer;
+	if (!writer.open(filename, width, height)) return false;
+
+	// bin front-facing triangles by the strips their screen bounding box touches, so each strip only
+	// sees its own share of the mesh
+	std::vector<std::vector<int>> bins(strip_count);
+	{
+		PROFILE_SCOPE("strip binning");
+		for (int i = 0; i < static_cast<int>(model.faces.size()); ++i)
+		{
+			if (model.faces[i].size() != 3) continue;
+			PROFILE_COUNT(TrianglesIn, 1);
+			stats.triangles_in++;
+
+			Vec3f v_screen[3];
+			{
+				PROFILE_STAGE(Vertex);
+				project_face(shader, i, width, height, v_screen);
+			}
+			bool culled;
+			{
+				PROFILE_STAGE(Cull);
+				culled = is_back_facing(v_screen);
+			}
+			if (culled)
+			{
+				PROFILE_COUNT(TrianglesCulled, 1);
+				stats.triangles_culled++;
+				continue;
+			}
+
+			// same clamping as drawTriangle's bounding box
+			int min_x = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
+			int max_x = static_cast<int>(std::min((float)width - 1, std::max({ v_screen[0].x, v_screen[1].x, v_screen[2].x })));
+			int min_y = static_cast<int>(std::max(0.0f, std::min({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
+			int max_y = static_cast<int>(std::min((float)height - 1, std::max({ v_screen[0].y, v_screen[1].y, v_screen[2].y })));
+			if (min_x > max_x || min_y > max_y)
+			{
+				PROFILE_COUNT(TrianglesOffscreen, 1); // never reaches a strip's drawTriangle to be counted there
+				continue;
+			}
+			stats.triangles_rasterized++;
+			for (int s = min_y / strip_rows; s <= max_y / strip_rows && s < strip_count; ++s) bins[s].push_back(i);
+		}
+	}
+
+	// the file wants the picture's top row first, which is the image's last row (see FrameWriter.h),
+	// so strips go bottom of the buffer to top
+	Image strip(width, strip_rows);
+	for (int s = strip_count - 1; s >= 0; --s)
+	{
+		PROFILE_SCOPE("strip");
+		int origin_y = s * strip_rows;
+		int rows = std::min(strip_rows, height - origin_y);
+
+		strip.clear_buffers();
+		strip.set_frame_region(width, height, 0, origin_y);
+		RenderStats strip_stats;
+		for (int face : bins[s]) draw_binned_face(strip, shader, face, strip_stats);
+		stats.fragments_shaded += strip_stats.fragments_shaded;
+
+		for (int y = rows - 1; y >= 0; --y) writer.write_row(&strip.get_buffer()[static_cast<std::size_t>(y) * width]);
+
+		std::vector<int>().swap(bins[s]); // done with it
+	}
+
+	return writer.close();
+}
+
+RenderStats render_model_cached(Image& image, const Model& model, PhongShader& shader, SurfaceCache& cache)
+{
+	SurfaceCacheKey key;
+	key.model = &model;
+	key.texture = shader.texture;
+	key.mvp = shader.uniform_mvp;
+	key.model_matrix = shader.uniform_model_matrix;
+	key.width = image.get_width();
+	key.height = image.get_height();
+	key.shading_rate = image.get_shading_rate();
+	key.shading_rate_map = image.get_shading_rate_map();
+
+	if (cache.matches(key))
+	{
+		PROFILE_SCOPE("relight");
+		relight(image, cache, shader);
+
+		RenderStats stats;
+		stats.relit = true;
+		return stats;
+	}
+
+	// geometry or camera changed, full render while capturing surfaces. starts from a clear image so
+	// the capture and the frame agree, a hit repaints every pixel from the capture
+	image.clear_buffers();
+	cache.reset(key);
+	shader.surface_cache = &cache;
+	RenderStats stats = render_model(image, model, shader);
+	shader.surface_cache = nullptr;
+	cache.finish();
+	return stats;
+}
+
+void relight(Image& image, const SurfaceCache& cache, const PhongShader& shader, int thread_count)
+{
+	const int width = std::min(image.get_width(), cache.get_width());
+	const int height = std::min(image.get_height(), cache.get_height());
+
+	if (thread_count <= 0) thread_count = static_cast<int>(std::thread::hardware_concurrency());
+	thread_count = std::max(1, std::min(thread_count, height));
+
+	// interleaved rows, so threads get a similar share of the covered area
+	auto relight_rows = [&](int first_row)
+	{
+		for (int y = first_row; y < height; y += thread_count)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const Surface& s = cache.at(x, y);
+				if (s.depth == std::numeric_limits<float>::infinity()) image.write_pixel(x, y, s.depth, black);
+				else image.write_pixel(x, y, s.depth, shader.shade(s.world_pos, s.normal, s.texture_color));
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < thread_count; ++t) workers.emplace_back(relight_rows, t);
+	relight_rows(0);
+	for (auto& worker : workers) worker.join();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Image.h"
+#include "Model.h"
+#include "IShader.h"
+#include "PhongShader.h"
+#include "SurfaceCache.h"
+#include <string>
+
+struct RenderStats {
+	int triangles_in = 0;
+	int triangles_culled = 0;
+	int triangles_rasterized = 0;
+	long long fragments_shaded = 0;
+	bool relit = false; // geometry came from a SurfaceCache, only lighting ran
+};
+
+// run every face of the model through the pipeline:
+// vertex shader, viewport transform, back-face culling, rasterization + fragment shader
+RenderStats render_model(Image& image, const Model& model, IShader& shader);
+
+// render a width x height frame in horizontal strips of strip_rows, each with its own color and depth buffer,
+// and stream the finished strips to filename (see FrameWriter.h, .ppm for frames over 65535). a pre-pass bins
+// the front-facing triangles per strip, counting each triangle once however many strips it touches
+bool render_model_strips(const Model& model, IShader& shader, int width, int height, int strip_rows, const std::string& filename,
+	RenderStats& stats);
+
+// render_model for the relighting workflow: when model, texture, matrices and viewport match the cache,
+// only the lighting is rerun over the cached pixels, otherwise the image is cleared and a full render refills the cache.
+// either way every pixel is rewritten, the caller doesnt need to clear
+RenderStats render_model_cached(Image& image, const Model& model, PhongShader& shader, SurfaceCache& cache);
+
+// rerun PhongShader::shade on every cached pixel, rows split over thread_count threads (0 = all cores)
+void relight(Image& image, const SurfaceCache& cache, const PhongShader& shader, int thread_count = 0);
@@ -0,0 +1,97 @@
+#include "ShadingRate.h"
+#include "Image.h"
+#include <algorithm> //std::max, std::min
+#include <cmath> //std::sqrt, std::log10, std::abs
+#include <limits> //std::numeric_limits
+
+ShadingRateMap::ShadingRateMap(int width, int height, ShadingRate rate)
+	: m_tiles_x((width + tile_size - 1) / tile_size), m_tiles_y((height + tile_size - 1) / tile_size)
+{
+	m_rates.resize(m_tiles_x * m_tiles_y, rate);
+}
+
+void ShadingRateMap::from_rate_image(const Texture& rate_image)
+{
+	if (rate_image.get_width() <= 0 || rate_image.get_height() <= 0) return;
+
+	for (int ty = 0; ty < m_tiles_y; ++ty)
+	{
+		for (int tx = 0; tx < m_tiles_x; ++tx)
+		{
+			// texel under the tile center
+			int x = (2 * tx + 1) * rate_image.get_width() / (2 * m_tiles_x);
+			int y = (2 * ty + 1) * rate_image.get_height() / (2 * m_tiles_y);
+			Color c = rate_image.texel(x, y);
+			ShadingRate rate = c.r < 85 ? ShadingRate::Rate1x1 : (c.r < 170 ? ShadingRate::Rate2x2 : ShadingRate::Rate4x4);
+			set_tile(tx, ty, rate);
+		}
+	}
+}
+
+static float luminance(const Color& c)
+{
+	return (0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b) / 255.0f;
+}
+
+void ShadingRateMap::from_luminance_gradient(const Image& previous_frame, float threshold_2x2, float threshold_4x4)
+{
+	const int width = previous_frame.get_width();
+	const int height = previous_frame.get_height();
+	const std::vector<Color>& pixels = previous_frame.get_buffer();
+
+	for (int ty = 0; ty < m_tiles_y; ++ty)
+	{
+		for (int tx = 0; tx < m_tiles_x; ++tx)
+		{
+			// steepest forward difference inside the tile, one pixel past its edge so borders count too
+			float max_gradient = 0.0f;
+			int x_end = std::min(width - 1, (tx + 1) * tile_size);
+			int y_end = std::min(height - 1, (ty + 1) * tile_size);
+			for (int y = ty * tile_size; y < y_end; ++y)
+			{
+				for (int x = tx * tile_size; x < x_end; ++x)
+				{
+					float l = luminance(pixels[y * width + x]);
+					float dx = std::abs(luminance(pixels[y * width + x + 1]) - l);
+					float dy = std::abs(luminance(pixels[(y + 1) * width + x]) - l);
+					max_gradient = std::max(max_gradient, std::max(dx, dy));
+				}
+			}
+
+			ShadingRate rate = ShadingRate::Rate1x1;
+			if (max_gradient < threshold_4x4) rate = ShadingRate::Rate4x4;
+			else if (max_gradient < threshold_2x2) rate = ShadingRate::Rate2x2;
+			set_tile(tx, ty, rate);
+		}
+	}
+}
+
+float ShadingRateMap::coverage(ShadingRate rate) const
+{
+	if (m_rates.empty()) return 0.0f;
+	return static_cast<float>(std::count(m_rates.begin(), m_rates.end(), rate)) / m_rates.size();
+}
+
+ImageError compare_images(const Image& a, const Image& b)
+{
+	ImageError error;
+	if (a.get_width() != b.get_width() || a.get_height() != b.get_height()) return error;
+
+	const std::vector<Color>& pa = a.get_buffer();
+	const std::vector<Color>& pb = b.get_buffer();
+	double sum_sq = 0;
+	for (std::size_t i = 0; i < pa.size(); ++i)
+	{
+		int d[3] = { pa[i].r - pb[i].r, pa[i].g - pb[i].g, pa[i].b - pb[i].b };
+		for (int c = 0; c < 3; ++c)
+		{
+			sum_sq += d[c] * d[c];
+			error.max_error = std::max(error.max_error, std::abs(d[c]));
+		}
+	}
+
+	double mse = sum_sq / (pa.size() * 3.0);
+	error.rmse = std::sqrt(mse);
+	error.psnr = mse == 0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / mse);
+	return error;
+}
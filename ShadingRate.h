@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Color.h"
+#include "Texture.h"
+
+class Image;
+
+// coarse shading: one fragment shader call per rate x rate block, coverage and depth stay per pixel
+enum class ShadingRate : std::uint8_t {
+	Rate1x1 = 1,
+	Rate2x2 = 2,
+	Rate4x4 = 4
+};
+
+inline ShadingRate coarser(ShadingRate a, ShadingRate b) { return a > b ? a : b; }
+
+// per-tile shading rates over the framebuffer
+class ShadingRateMap {
+public:
+	static const int tile_size = 16; // multiple of every block size, blocks never straddle tiles
+
+	ShadingRateMap() = default;
+	ShadingRateMap(int width, int height, ShadingRate rate = ShadingRate::Rate1x1);
+
+	void set_tile(int tile_x, int tile_y, ShadingRate rate) { m_rates[tile_y * m_tiles_x + tile_x] = rate; }
+	ShadingRate get_tile(int tile_x, int tile_y) const { return m_rates[tile_y * m_tiles_x + tile_x]; }
+	ShadingRate at_pixel(int x, int y) const { return m_rates[(y / tile_size) * m_tiles_x + x / tile_size]; }
+
+	// user-supplied rate image, texel under each tile center (any resolution):
+	// red < 85 -> 1x1, red < 170 -> 2x2, otherwise 4x4
+	void from_rate_image(const Texture& rate_image);
+
+	// automatic rates from a previous frame: tiles whose steepest luminance step (0..1 per pixel)
+	// stays under threshold_4x4 / threshold_2x2 get shaded at 4x4 / 2x2
+	void from_luminance_gradient(const Image& previous_frame, float threshold_2x2 = 0.08f, float threshold_4x4 = 0.03f);
+
+	int get_tiles_x() const { return m_tiles_x; }
+	int get_tiles_y() const { return m_tiles_y; }
+	// share of tiles at the given rate, 0..1
+	float coverage(ShadingRate rate) const;
+
+private:
+	int m_tiles_x = 0;
+	int m_tiles_y = 0;
+	std::vector<ShadingRate> m_rates;
+};
+
+// difference between a coarse-shaded frame and its full-rate reference
+struct ImageError {
+	double rmse = 0; // over rgb, in 0..255 units
+	double psnr = 0; // dB, infinity for identical images
+	int max_error = 0; // largest single channel difference
+};
+
+ImageError compare_images(const Image& a, const Image& b);
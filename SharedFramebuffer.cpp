@@ -0,0 +1,294 @@
+#include "SharedFramebuffer.h"
+#include <cstring> //std::memcpy
+#include <new> //placement new
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const std::size_t slot_alignment = 64; // cache line, so slots never share one
+
+static std::size_t align_up(std::size_t size, std::size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+/* -- SharedMemory -- */
+
+#ifdef _WIN32
+
+bool SharedMemory::create(const std::string& name, std::size_t size)
+{
+	close();
+	std::string object_name = "Local\\" + name;
+	HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), object_name.c_str());
+	if (!handle)
+	{
+		std::cerr << "error: cant create shared memory " << name << std::endl;
+		return false;
+	}
+
+	m_data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!m_data)
+	{
+		std::cerr << "error: cant map shared memory " << name << std::endl;
+		CloseHandle(handle);
+		return false;
+	}
+
+	m_handle = handle;
+	m_size = size;
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name)
+{
+	close();
+	std::string object_name = "Local\\" + name;
+	HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, object_name.c_str());
+	if (!handle)
+	{
+		std::cerr << "error: cant open shared memory " << name << std::endl;
+		return false;
+	}
+
+	m_data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		std::cerr << "error: cant map shared memory " << name << std::endl;
+		CloseHandle(handle);
+		return false;
+	}
+
+	MEMORY_BASIC_INFORMATION info;
+	VirtualQuery(m_data, &info, sizeof(info));
+	m_handle = handle;
+	m_size = info.RegionSize;
+	return true;
+}
+
+void SharedMemory::close()
+{
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_handle) CloseHandle(static_cast<HANDLE>(m_handle));
+	m_data = nullptr;
+	m_handle = nullptr;
+	m_size = 0;
+}
+
+#else
+
+bool SharedMemory::create(const std::string& name, std::size_t size)
+{
+	close();
+	std::string object_name = "/" + name;
+	shm_unlink(object_name.c_str()); // drop a stale ring from a previous run
+
+	int fd = shm_open(object_name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		std::cerr << "error: cant create shared memory " << name << std::endl;
+		return false;
+	}
+
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+	{
+		std::cerr << "error: cant resize shared memory " << name << std::endl;
+		::close(fd);
+		shm_unlink(object_name.c_str());
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the object alive
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "error: cant map shared memory " << name << std::endl;
+		shm_unlink(object_name.c_str());
+		return false;
+	}
+
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name)
+{
+	close();
+	std::string object_name = "/" + name;
+	int fd = shm_open(object_name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		std::cerr << "error: cant open shared memory " << name << std::endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		std::cerr << "error: shared memory " << name << " is empty" << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "error: cant map shared memory " << name << std::endl;
+		return false;
+	}
+
+	m_data = data;
+	m_size = static_cast<std::size_t>(st.st_size);
+	return true;
+}
+
+void SharedMemory::close()
+{
+	// the ring is left in place, a viewer can still pick up the last frame after the renderer exits.
+	// the next create() with the same name replaces it
+	if (m_data) munmap(m_data, m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
+
+/* -- SharedFramebuffer (writer) -- */
+
+bool SharedFramebuffer::create(const std::string& name, int width, int height, int slot_count)
+{
+	if (width <= 0 || height <= 0 || slot_count < 2)
+	{
+		std::cerr << "error: invalid shared framebuffer size " << width << "x" << height << " x" << slot_count << std::endl;
+		return false;
+	}
+
+	std::size_t slots_offset = align_up(sizeof(SharedFrameHeader), slot_alignment);
+	std::size_t data_offset = align_up(slots_offset + sizeof(SharedFrameSlot) * slot_count, slot_alignment);
+	std::size_t slot_stride = align_up(sizeof(Color) * width * height, slot_alignment);
+	std::size_t total_size = data_offset + slot_stride * slot_count;
+
+	if (!m_memory.create(name, total_size)) return false;
+
+	// fresh mapping is zero-filled: every slot sequence starts at 0 (empty, nothing published)
+	m_header = new (m_memory.data()) SharedFrameHeader();
+	for (int i = 0; i < slot_count; ++i)
+		new (static_cast<char*>(m_memory.data()) + slots_offset + i * sizeof(SharedFrameSlot)) SharedFrameSlot();
+
+	m_header->width = width;
+	m_header->height = height;
+	m_header->slot_count = slot_count;
+	m_header->bytes_per_pixel = sizeof(Color);
+	m_header->data_offset = data_offset;
+	m_header->slot_stride = slot_stride;
+	m_header->sequence.store(0, std::memory_order_relaxed);
+	m_header->version = shared_frame_version;
+	// magic last, a reader treats the ring as ready once it sees it
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = shared_frame_magic;
+
+	m_frame = 0;
+	std::cout << "shared framebuffer: " << name << " | " << width << "x" << height
+		<< " | slots: " << slot_count << " | " << total_size / 1024 << " KiB" << std::endl;
+	return true;
+}
+
+std::uint64_t SharedFramebuffer::publish(const Image& image)
+{
+	if (!m_header) return 0;
+	if (image.get_width() != static_cast<int>(m_header->width) || image.get_height() != static_cast<int>(m_header->height))
+	{
+		std::cerr << "error: image size doesnt match shared framebuffer" << std::endl;
+		return 0;
+	}
+
+	std::uint64_t frame = ++m_frame;
+	std::size_t slot_index = (frame - 1) % m_header->slot_count;
+
+	char* base = static_cast<char*>(m_memory.data());
+	auto* slot = reinterpret_cast<SharedFrameSlot*>(base + align_up(sizeof(SharedFrameHeader), slot_alignment)) + slot_index;
+	char* pixels = base + m_header->data_offset + slot_index * m_header->slot_stride;
+
+	// odd = being written, readers holding the old frame in this slot will see it invalidated
+	slot->sequence.store(frame * 2 - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	// the image's row 0 is the bottom of the picture (see FrameWriter.h), the ring is top row first
+	const std::size_t row_bytes = sizeof(Color) * m_header->width;
+	const Color* rows = image.get_buffer().data();
+	for (std::uint32_t y = 0; y < m_header->height; ++y)
+		std::memcpy(pixels + y * row_bytes, rows + static_cast<std::size_t>(m_header->height - 1 - y) * m_header->width, row_bytes);
+
+	slot->sequence.store(frame * 2, std::memory_order_release);
+	m_header->sequence.store(frame, std::memory_order_release);
+	return frame;
+}
+
+/* -- SharedFrameReader -- */
+
+bool SharedFrameReader::open(const std::string& name)
+{
+	m_header = nullptr;
+	if (!m_memory.open(name)) return false;
+
+	const auto* header = static_cast<const SharedFrameHeader*>(m_memory.data());
+	if (m_memory.size() < sizeof(SharedFrameHeader) || header->magic != shared_frame_magic || header->version != shared_frame_version)
+	{
+		std::cerr << "error: " << name << " is not a shared framebuffer" << std::endl;
+		m_memory.close();
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	m_header = header;
+	return true;
+}
+
+const SharedFrameSlot& SharedFrameReader::slot_for(std::uint64_t frame) const
+{
+	const char* base = static_cast<const char*>(m_memory.data());
+	const auto* slots = reinterpret_cast<const SharedFrameSlot*>(base + align_up(sizeof(SharedFrameHeader), slot_alignment));
+	return slots[(frame - 1) % m_header->slot_count];
+}
+
+const Color* SharedFrameReader::acquire_latest(std::uint64_t& frame) const
+{
+	if (!m_header) return nullptr;
+
+	// the writer can lap us between reading the header and the slot, just look again
+	for (int attempt = 0; attempt < 4; ++attempt)
+	{
+		frame = m_header->sequence.load(std::memory_order_acquire);
+		if (frame == 0) return nullptr;
+
+		if (slot_for(frame).sequence.load(std::memory_order_acquire) == frame * 2)
+		{
+			const char* base = static_cast<const char*>(m_memory.data());
+			std::size_t slot_index = (frame - 1) % m_header->slot_count;
+			return reinterpret_cast<const Color*>(base + m_header->data_offset + slot_index * m_header->slot_stride);
+		}
+	}
+
+	return nullptr;
+}
+
+bool SharedFrameReader::is_valid(std::uint64_t frame) const
+{
+	if (!m_header || frame == 0) return false;
+
+	// order the pixel reads before re-checking the sequence
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot_for(frame).sequence.load(std::memory_order_relaxed) == frame * 2;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "Color.h"
+#include "Image.h"
+
+// publishes rendered frames into a named shared-memory ring so a local viewer/encoder
+// can read them in place, no file round trip through output.tga
+//
+// layout: SharedFrameHeader | SharedFrameSlot[slot_count] | pixels of slot 0 | pixels of slot 1 | ...
+// pixels are Color (b,g,r,a bytes), top row of the picture first (Image's last row), width * height per slot
+//
+// each slot is a seqlock: the writer bumps the slot sequence to an odd value, copies the frame,
+// then bumps it to the next even value. readers never take a lock, they check the slot sequence
+// before and after touching the pixels. the writer never waits on readers, a reader that falls
+// more than slot_count - 1 frames behind just sees its frame invalidated
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory frames need lock-free 64-bit atomics");
+
+const std::uint32_t shared_frame_magic = 0x42465352; // "RSFB"
+const std::uint32_t shared_frame_version = 2; // 2: rows really are top first (1 wrote them bottom-up)
+
+struct SharedFrameHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t slot_count;
+	std::uint32_t bytes_per_pixel;
+	std::uint64_t data_offset; // from the start of the mapping to slot 0's pixels
+	std::uint64_t slot_stride; // bytes between consecutive slots' pixels
+	std::atomic<std::uint64_t> sequence; // number of the last published frame, 0 = nothing yet
+};
+
+struct SharedFrameSlot {
+	std::atomic<std::uint64_t> sequence; // 2 * frame while readable, odd while being written
+};
+
+// platform shared-memory mapping, POSIX shm_open / win32 named file mapping
+class SharedMemory {
+public:
+	SharedMemory() = default;
+	~SharedMemory() { close(); }
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	bool create(const std::string& name, std::size_t size);
+	bool open(const std::string& name);
+	void close();
+
+	void* data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+
+private:
+	void* m_data = nullptr;
+	std::size_t m_size = 0;
+#ifdef _WIN32
+	void* m_handle = nullptr;
+#endif
+};
+
+// writer side, used by the renderer
+class SharedFramebuffer {
+public:
+	// create (or replace) the ring, slot_count >= 2 so a reader always has a complete frame
+	bool create(const std::string& name, int width, int height, int slot_count = 3);
+
+	// copy the image's color buffer into the next slot and publish it, returns the frame number (0 on error)
+	std::uint64_t publish(const Image& image);
+
+private:
+	SharedMemory m_memory;
+	SharedFrameHeader* m_header = nullptr;
+	std::uint64_t m_frame = 0; // last published
+};
+
+// reader side, for preview/encoder processes
+class SharedFrameReader {
+public:
+	bool open(const std::string& name);
+
+	int get_width() const { return m_header ? m_header->width : 0; }
+	int get_height() const { return m_header ? m_header->height : 0; }
+
+	// newest published frame, in place (no copy), nullptr if nothing is published yet.
+	// check is_valid(frame) after using the pixels
+	const Color* acquire_latest(std::uint64_t& frame) const;
+
+	// false once the writer has started overwriting the frame's slot, drop whatever was read from it
+	bool is_valid(std::uint64_t frame) const;
+
+private:
+	SharedMemory m_memory;
+	const SharedFrameHeader* m_header = nullptr;
+
+	const SharedFrameSlot& slot_for(std::uint64_t frame) const;
+};
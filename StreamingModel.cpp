@@ -0,0 +1,367 @@
+#include "StreamingModel.h"
+#include "Profiler.h"
+#include <algorithm> //std::max
+#include <cstring> //std::memcpy
+#include <iterator> //std::prev
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+const std::size_t page_bytes = 64 * 1024;
+
+// worst case for one triangle in a chunk: the face itself (vector + 3 indices + heap header),
+// three new positions/uvs/normals and their remap entries (~56 bytes per unordered_map node + bucket)
+const std::size_t bytes_per_face = sizeof(std::vector<FaceIndex>) + 3 * sizeof(FaceIndex) + 16
+	+ 3 * (2 * sizeof(Vec3f) + sizeof(Vec2f)) + 9 * 56;
+
+static bool seek_file(std::FILE* file, std::int64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+/* -- AttributeStore -- */
+
+AttributeStore::AttributeStore(std::size_t record_size)
+	: m_record_size(record_size), m_page_records(page_bytes / record_size), m_page_bytes(m_page_records * record_size)
+{
+}
+
+AttributeStore::~AttributeStore()
+{
+	close();
+}
+
+bool AttributeStore::open()
+{
+	close();
+	m_file = std::tmpfile();
+	if (!m_file)
+	{
+		std::cerr << "error: cant create temp file for streamed attributes" << std::endl;
+		return false;
+	}
+	m_write_buffer.reserve(m_page_bytes);
+	return true;
+}
+
+bool AttributeStore::append(const void* record)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(record);
+	m_write_buffer.insert(m_write_buffer.end(), bytes, bytes + m_record_size);
+	m_count++;
+	if (m_write_buffer.size() < m_page_bytes) return true;
+
+	bool ok = std::fwrite(m_write_buffer.data(), 1, m_write_buffer.size(), m_file) == m_write_buffer.size();
+	m_write_buffer.clear();
+	return ok;
+}
+
+bool AttributeStore::finish_writing()
+{
+	bool ok = m_write_buffer.empty() || std::fwrite(m_write_buffer.data(), 1, m_write_buffer.size(), m_file) == m_write_buffer.size();
+	std::vector<std::uint8_t>().swap(m_write_buffer);
+	return ok && std::fflush(m_file) == 0;
+}
+
+bool AttributeStore::read(std::int64_t index, void* out)
+{
+	if (index < 0 || index >= m_count) return false;
+
+	std::int64_t number = index / m_page_records;
+	auto it = m_page_index.find(number);
+	if (it != m_page_index.end())
+	{
+		m_hits++;
+		m_pages.splice(m_pages.begin(), m_pages, it->second); // mark most recently used
+	}
+	else
+	{
+		m_misses++;
+		// reuse the least recently used page's buffer once the cache is full
+		if (m_pages.size() >= m_max_pages)
+		{
+			m_page_index.erase(m_pages.back().number);
+			m_pages.splice(m_pages.begin(), m_pages, std::prev(m_pages.end()));
+		}
+		else m_pages.emplace_front();
+
+		Page& page = m_pages.front();
+		page.number = number;
+		page.data.resize(m_page_bytes);
+		std::size_t records = static_cast<std::size_t>(std::min<std::int64_t>(m_page_records, m_count - number * m_page_records));
+		if (!seek_file(m_file, number * static_cast<std::int64_t>(m_page_bytes)) ||
+			std::fread(page.data.data(), m_record_size, records, m_file) != records)
+		{
+			std::cerr << "error: cant read streamed attributes back from temp file" << std::endl;
+			m_pages.pop_front();
+			return false;
+		}
+		m_page_index[number] = m_pages.begin();
+	}
+
+	std::memcpy(out, &m_pages.front().data[(index % m_page_records) * m_record_size], m_record_size);
+	return true;
+}
+
+void AttributeStore::close()
+{
+	if (m_file) std::fclose(m_file); // tmpfile is deleted on close
+	m_file = nullptr;
+	m_count = 0;
+	m_write_buffer.clear();
+	m_pages.clear();
+	m_page_index.clear();
+	m_hits = m_misses = 0;
+}
+
+void AttributeStore::set_cache_budget(std::size_t bytes)
+{
+	m_max_pages = std::max<std::size_t>(1, bytes / m_page_bytes);
+	while (m_pages.size() > m_max_pages)
+	{
+		m_page_index.erase(m_pages.back().number);
+		m_pages.pop_back();
+	}
+}
+
+/* -- StreamingModel -- */
+
+StreamingModel::StreamingModel(std::size_t memory_budget)
+	: m_budget(memory_budget), m_vertices(sizeof(Vec3f)), m_uvs(sizeof(Vec2f)), m_normals(sizeof(Vec3f))
+{
+	// half for the page caches, split evenly, half for the chunk
+	std::size_t cache_budget = m_budget / 2;
+	m_vertices.set_cache_budget(cache_budget / 3);
+	m_uvs.set_cache_budget(cache_budget / 3);
+	m_normals.set_cache_budget(cache_budget / 3);
+	m_chunk_faces = static_cast<int>(std::max<std::size_t>(1, (m_budget - cache_budget) / bytes_per_face));
+}
+
+// first word of an OBJ line, "" for blank lines
+static std::string line_prefix(const std::string& line, std::size_t& end)
+{
+	std::size_t begin = line.find_first_not_of(" \t");
+	if (begin == std::string::npos) return "";
+	end = line.find_first_of(" \t", begin);
+	if (end == std::string::npos) end = line.size();
+	return line.substr(begin, end - begin);
+}
+
+bool StreamingModel::open(const std::string& filename)
+{
+	PROFILE_SCOPE("stream pass 1");
+	std::ifstream in(filename);
+	if (!in)
+	{
+		std::cerr << "error: cant open " << filename << std::endl;
+		return false;
+	}
+
+	m_filename = filename;
+	m_face_count = 0;
+	if (!m_vertices.open() || !m_uvs.open() || !m_normals.open()) return false;
+
+	// same conventions as Model::Model
+	bool ok = true;
+	std::string line;
+	while (ok && std::getline(in, line))
+	{
+		std::size_t end = 0;
+		std::string prefix = line_prefix(line, end);
+		if (prefix == "f")
+		{
+			m_face_count++;
+			continue;
+		}
+
+		std::stringstream ss(line.substr(end));
+		if (prefix == "v") // vertex
+		{
+			Vec3f v;
+			ss >> v.x >> v.y >> v.z;
+			v.y = -v.y; // invert y for right-handed coord system
+			ok = m_vertices.append(&v);
+		}
+		else if (prefix == "vt") // texture coord
+		{
+			Vec2f uv;
+			ss >> uv.x >> uv.y;
+			ok = m_uvs.append(&uv);
+		}
+		else if (prefix == "vn") // normal
+		{
+			Vec3f n;
+			ss >> n.x >> n.y >> n.z;
+			n = n.normalize();
+			ok = m_normals.append(&n);
+		}
+	}
+
+	ok = ok && m_vertices.finish_writing() && m_uvs.finish_writing() && m_normals.finish_writing();
+	if (!ok)
+	{
+		std::cerr << "error: cant write streamed attributes to temp file" << std::endl;
+		return false;
+	}
+
+	std::int64_t spilled = m_vertices.size() * sizeof(Vec3f) + m_uvs.size() * sizeof(Vec2f) + m_normals.size() * sizeof(Vec3f);
+	std::cout << "model indexed: " << filename
+		<< " | vertices: " << m_vertices.size()
+		<< " | uvs: " << m_uvs.size()
+		<< " | normals: " << m_normals.size()
+		<< " | faces: " << m_face_count
+		<< " | spilled: " << spilled / (1024 * 1024) << " MiB" << std::endl;
+	return true;
+}
+
+// index of the attribute in the chunk, pulled from the store the first time the chunk needs it. -1 on error
+template <typename T>
+static int resolve(std::int64_t index, AttributeStore& store, std::unordered_map<std::int64_t, int>& remap, std::vector<T>& local)
+{
+	auto it = remap.find(index);
+	if (it != remap.end()) return it->second;
+
+	T value;
+	if (!store.read(index, &value)) return -1;
+	local.push_back(value);
+	remap.emplace(index, static_cast<int>(local.size()) - 1);
+	return static_cast<int>(local.size()) - 1;
+}
+
+bool StreamingModel::add_face(Model& chunk, const std::vector<FaceIndex>& face)
+{
+	std::vector<FaceIndex> local(3);
+	for (int j = 0; j < 3; ++j)
+	{
+		local[j].v_idx = resolve(face[j].v_idx, m_vertices, m_vertex_remap, chunk.vertices);
+		if (local[j].v_idx < 0) return false;
+
+		// PhongShader needs every attribute, fill in what the file leaves out
+		if (face[j].vt_idx >= 0) local[j].vt_idx = resolve(face[j].vt_idx, m_uvs, m_uv_remap, chunk.uvs);
+		else
+		{
+			chunk.uvs.push_back({ 0, 0 });
+			local[j].vt_idx = static_cast<int>(chunk.uvs.size()) - 1;
+		}
+		if (local[j].vt_idx < 0) return false;
+
+		if (face[j].vn_idx >= 0)
+		{
+			local[j].vn_idx = resolve(face[j].vn_idx, m_normals, m_normal_remap, chunk.normals);
+			if (local[j].vn_idx < 0) return false;
+		}
+	}
+
+	if (face[0].vn_idx < 0 || face[1].vn_idx < 0 || face[2].vn_idx < 0)
+	{
+		// flat normal, facing the same side as the OBJ's counter-clockwise winding before the y flip
+		const Vec3f& p0 = chunk.vertices[local[0].v_idx];
+		const Vec3f& p1 = chunk.vertices[local[1].v_idx];
+		const Vec3f& p2 = chunk.vertices[local[2].v_idx];
+		Vec3f n = (p2 - p0).cross(p1 - p0).normalize();
+		n.y = -n.y;
+		chunk.normals.push_back(n);
+		for (int j = 0; j < 3; ++j)
+			if (face[j].vn_idx < 0) local[j].vn_idx = static_cast<int>(chunk.normals.size()) - 1;
+	}
+
+	chunk.faces.push_back(std::move(local));
+	return true;
+}
+
+std::size_t StreamingModel::chunk_bytes(const Model& chunk) const
+{
+	std::size_t remap_entries = m_vertex_remap.size() + m_uv_remap.size() + m_normal_remap.size();
+	std::size_t remap_buckets = m_vertex_remap.bucket_count() + m_uv_remap.bucket_count() + m_normal_remap.bucket_count();
+	return chunk.vertices.capacity() * sizeof(Vec3f)
+		+ chunk.uvs.capacity() * sizeof(Vec2f)
+		+ chunk.normals.capacity() * sizeof(Vec3f)
+		+ chunk.faces.capacity() * sizeof(std::vector<FaceIndex>)
+		+ chunk.faces.size() * (3 * sizeof(FaceIndex) + 16)
+		+ remap_entries * 48 + remap_buckets * sizeof(void*);
+}
+
+RenderStats StreamingModel::render(Image& image, PhongShader& shader)
+{
+	PROFILE_SCOPE("stream pass 2");
+	RenderStats total;
+	std::ifstream in(m_filename);
+	if (!in)
+	{
+		std::cerr << "error: cant open " << m_filename << std::endl;
+		return total;
+	}
+
+	// capacity fixed up front so the chunk never grows past the budget
+	Model chunk;
+	chunk.faces.reserve(m_chunk_faces);
+	chunk.vertices.reserve(m_chunk_faces * 3);
+	chunk.uvs.reserve(m_chunk_faces * 3);
+	chunk.normals.reserve(m_chunk_faces * 3);
+
+	const Model* original_model = shader.model;
+	m_peak_bytes = 0;
+	int chunks = 0;
+	std::int64_t skipped = 0;
+
+	auto flush_chunk = [&]()
+	{
+		if (chunk.faces.empty()) return;
+
+		std::size_t resident = chunk_bytes(chunk) + m_vertices.get_resident_bytes() + m_uvs.get_resident_bytes() + m_normals.get_resident_bytes();
+		m_peak_bytes = std::max(m_peak_bytes, resident);
+
+		shader.model = &chunk;
+		RenderStats stats = render_model(image, chunk, shader);
+		total.triangles_in += stats.triangles_in;
+		total.triangles_culled += stats.triangles_culled;
+		total.triangles_rasterized += stats.triangles_rasterized;
+		total.fragments_shaded += stats.fragments_shaded;
+		chunks++;
+
+		chunk.vertices.clear();
+		chunk.uvs.clear();
+		chunk.normals.clear();
+		chunk.faces.clear();
+		m_vertex_remap.clear();
+		m_uv_remap.clear();
+		m_normal_remap.clear();
+	};
+
+	std::string line;
+	std::vector<FaceIndex> face;
+	while (std::getline(in, line))
+	{
+		std::size_t end = 0;
+		if (line_prefix(line, end) != "f") continue;
+
+		face.clear();
+		std::stringstream ss(line.substr(end));
+		std::string token;
+		while (ss >> token) face.push_back(Model::parse_face_index(token));
+
+		// render_model only draws triangles, dont spend chunk space on anything else
+		if (face.size() != 3 || !add_face(chunk, face))
+		{
+			skipped++;
+			continue;
+		}
+		if (static_cast<int>(chunk.faces.size()) >= m_chunk_faces) flush_chunk();
+	}
+	flush_chunk();
+	shader.model = original_model;
+
+	std::uint64_t hits = m_vertices.get_hits() + m_uvs.get_hits() + m_normals.get_hits();
+	std::uint64_t misses = m_vertices.get_misses() + m_uvs.get_misses() + m_normals.get_misses();
+	std::cout << "streamed: " << m_filename
+		<< " | faces: " << total.triangles_in
+		<< " | chunks: " << chunks << " x " << m_chunk_faces << " faces"
+		<< " | page hits: " << hits << " misses: " << misses
+		<< " | peak: " << m_peak_bytes / 1024 << " KiB of " << m_budget / 1024 << " KiB budget" << std::endl;
+	if (skipped > 0) std::cerr << "warning: skipped " << skipped << " faces (not triangles or bad indices)" << std::endl;
+	return total;
+}
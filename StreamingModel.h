@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Model.h"
+#include "Image.h"
+#include "PhongShader.h"
+#include "Renderer.h"
+
+// out-of-core rendering for OBJ files too big to load as a Model
+//
+// pass 1 (open) parses v/vt/vn lines into fixed-size records in anonymous temp files and only counts faces.
+// pass 2 (render) reads the file again, collects faces into a small Model chunk, pulls the attributes each
+// face references through an LRU page cache over the temp files and renders the chunk once it is full.
+// cached pages plus the chunk stay under the memory budget, whatever the size of the mesh
+
+// fixed-size records in a temp file (deleted on close), read back through a bounded LRU page cache
+class AttributeStore {
+public:
+	explicit AttributeStore(std::size_t record_size);
+	~AttributeStore();
+	AttributeStore(const AttributeStore&) = delete;
+	AttributeStore& operator=(const AttributeStore&) = delete;
+
+	bool open();
+	bool append(const void* record);
+	// flush pending appends, call before the first read
+	bool finish_writing();
+	// copy record index to out, false if out of range or the read fails
+	bool read(std::int64_t index, void* out);
+	void close();
+
+	// how much the page cache may keep resident
+	void set_cache_budget(std::size_t bytes);
+
+	std::int64_t size() const { return m_count; }
+	std::size_t get_resident_bytes() const { return m_pages.size() * m_page_bytes + m_write_buffer.capacity(); }
+	std::uint64_t get_hits() const { return m_hits; }
+	std::uint64_t get_misses() const { return m_misses; }
+
+private:
+	struct Page {
+		std::int64_t number;
+		std::vector<std::uint8_t> data;
+	};
+
+	std::FILE* m_file = nullptr;
+	std::size_t m_record_size;
+	std::size_t m_page_records;
+	std::size_t m_page_bytes;
+	std::size_t m_max_pages = 1;
+	std::int64_t m_count = 0;
+
+	std::vector<std::uint8_t> m_write_buffer; // records not written to the file yet
+	std::list<Page> m_pages; // most recently used first
+	std::unordered_map<std::int64_t, std::list<Page>::iterator> m_page_index;
+	std::uint64_t m_hits = 0;
+	std::uint64_t m_misses = 0;
+};
+
+class StreamingModel {
+public:
+	// memory_budget covers the page caches and the face chunk, half each
+	explicit StreamingModel(std::size_t memory_budget = 64u << 20);
+
+	// pass 1: spill attributes to temp files and count faces
+	bool open(const std::string& filename);
+
+	// pass 2: stream the faces through render_model chunk by chunk, shader.model points at the current chunk
+	// while rendering and is restored afterwards
+	RenderStats render(Image& image, PhongShader& shader);
+
+	std::int64_t get_vertex_count() const { return m_vertices.size(); }
+	std::int64_t get_face_count() const { return m_face_count; }
+	int get_chunk_faces() const { return m_chunk_faces; }
+	// highest page cache + chunk memory seen during the last render
+	std::size_t get_peak_bytes() const { return m_peak_bytes; }
+
+private:
+	std::string m_filename;
+	std::size_t m_budget;
+	int m_chunk_faces;
+	std::int64_t m_face_count = 0;
+	std::size_t m_peak_bytes = 0;
+
+	AttributeStore m_vertices;
+	AttributeStore m_uvs;
+	AttributeStore m_normals;
+
+	bool add_face(Model& chunk, const std::vector<FaceIndex>& face);
+	std::size_t chunk_bytes(const Model& chunk) const;
+
+	// global attribute index -> index in the current chunk
+	std::unordered_map<std::int64_t, int> m_vertex_remap;
+	std::unordered_map<std::int64_t, int> m_uv_remap;
+	std::unordered_map<std::int64_t, int> m_normal_remap;
+};
@@ -0,0 +1,10 @@
+#include "SurfaceCache.h"
+#include <algorithm> //std::fill
+
+void SurfaceCache::reset(const SurfaceCacheKey& key)
+{
+	m_valid = false;
+	m_key = key;
+	m_surfaces.resize(static_cast<std::size_t>(key.width) * key.height);
+	std::fill(m_surfaces.begin(), m_surfaces.end(), Surface());
+}
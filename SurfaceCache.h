@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <limits> //std::numeric_limits
+#include "Vec.h"
+#include "Color.h"
+#include "Mat4f.h"
+#include "Model.h"
+#include "Texture.h"
+#include "ShadingRate.h"
+
+// one rasterized pixel, everything PhongShader::shade needs to light it again
+struct Surface {
+	Vec3f world_pos;
+	Vec3f normal;
+	Color texture_color;
+	float depth = std::numeric_limits<float>::infinity(); // infinity = nothing covers the pixel
+};
+
+// inputs the cached surfaces depend on. lights and material constants are deliberately not part of it
+struct SurfaceCacheKey {
+	const Model* model = nullptr;
+	const Texture* texture = nullptr;
+	Mat4f mvp;
+	Mat4f model_matrix;
+	int width = 0;
+	int height = 0;
+	// coarse shading stores one surface per block, so the rates pick which surfaces get cached
+	ShadingRate shading_rate = ShadingRate::Rate1x1;
+	const ShadingRateMap* shading_rate_map = nullptr;
+
+	bool operator==(const SurfaceCacheKey& other) const
+	{
+		return model == other.model && texture == other.texture && mvp.m == other.mvp.m
+			&& model_matrix.m == other.model_matrix.m && width == other.width && height == other.height
+			&& shading_rate == other.shading_rate && shading_rate_map == other.shading_rate_map;
+	}
+};
+
+// per-pixel g-buffer of the last full render, lets light/material tweaks skip transform, culling and rasterization
+class SurfaceCache {
+public:
+	SurfaceCache() = default;
+
+	// start capturing a new frame for key
+	void reset(const SurfaceCacheKey& key);
+	// true if the cache holds a complete frame rendered with the same geometry inputs
+	bool matches(const SurfaceCacheKey& key) const { return m_valid && m_key == key; }
+	// mark the capture complete
+	void finish() { m_valid = true; }
+	// call after editing model/texture data or the shading rate map in place, pointers alone cant tell
+	void invalidate() { m_valid = false; }
+
+	void store(int x, int y, const Surface& surface)
+	{
+		if (x < 0 || x >= m_key.width || y < 0 || y >= m_key.height) return;
+		m_surfaces[y * m_key.width + x] = surface;
+	}
+	const Surface& at(int x, int y) const { return m_surfaces[y * m_key.width + x]; }
+
+	int get_width() const { return m_key.width; }
+	int get_height() const { return m_key.height; }
+
+private:
+	bool m_valid = false;
+	SurfaceCacheKey m_key;
+	std::vector<Surface> m_surfaces;
+};
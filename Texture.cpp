@@ -1,4 +1,9 @@
 #include "Texture.h"
+#include <cstring> //std::memcpy
+#include <algorithm> //std::min, std::max
+#include <atomic>
+#include <cmath> //std::log10
+#include "BlockCompression.h"
 
 #pragma pack(push, 1)
 struct TGAHeader {
@@ -13,11 +18,74 @@ struct TGAHeader {
 	std::uint8_t bits_per_pixel;
 	std::uint8_t image_descriptor;
 };
+
+struct DDSPixelFormat {
+	std::uint32_t size;
+	std::uint32_t flags;
+	std::uint32_t four_cc;
+	std::uint32_t rgb_bit_count;
+	std::uint32_t r_mask;
+	std::uint32_t g_mask;
+	std::uint32_t b_mask;
+	std::uint32_t a_mask;
+};
+
+struct DDSHeader {
+	std::uint32_t magic;
+	std::uint32_t size;
+	std::uint32_t flags;
+	std::uint32_t height;
+	std::uint32_t width;
+	std::uint32_t linear_size;
+	std::uint32_t depth;
+	std::uint32_t mip_map_count;
+	std::uint32_t reserved1[11];
+	DDSPixelFormat pixel_format;
+	std::uint32_t caps;
+	std::uint32_t caps2;
+	std::uint32_t caps3;
+	std::uint32_t caps4;
+	std::uint32_t reserved2;
+};
 #pragma pack(pop)
 
+const std::uint32_t dds_magic = 0x20534444; // "DDS "
+const std::uint32_t dds_fourcc_dxt1 = 0x31545844; // "DXT1"
+const std::uint32_t dds_fourcc_dxt5 = 0x35545844; // "DXT5"
+const std::uint32_t ddpf_fourcc = 0x4;
+
+// decoded-block cache: direct mapped, one per thread so sampling never locks.
+// a slot covers a 16x16 block window (64x64 texels), neighbouring blocks never evict each other
+// kept trivially constructible (zero key = empty, texture ids start at 1) so the thread_local needs no init guard
+struct DecodedBlock {
+	std::uint64_t key;  // texture id << 32 | block index
+	std::uint8_t texels[16][4];  // Color layout
+};
+const int decoded_block_cache_size = 256;  // 18 KiB per thread
+static thread_local DecodedBlock decoded_block_cache[decoded_block_cache_size];
+
+static int block_bytes(TextureFormat format)
+{
+	return format == TextureFormat::BC1 ? bc1_block_bytes : bc3_block_bytes;
+}
 
+static const char* format_name(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1: return "BC1";
+	case TextureFormat::BC3: return "BC3";
+	default: return "raw";
+	}
+}
 
-bool Texture::load_tga_file(const std::string& filename)
+void Texture::new_id()
+{
+	static std::atomic<std::uint32_t> next_id{ 1 };
+	m_id = next_id++;
+}
+
+bool Texture::load_tga_file(const std::string& filename, TextureFormat format)
 {
 	std::ifstream in(filename, std::ios::binary);
 	if (!in)
@@ -44,6 +112,8 @@ bool Texture::load_tga_file(const std::string& filename)
 	m_width = header.width;
 	m_height = header.height;
 	m_bytes_per_pixel = header.bits_per_pixel / 8;
+	m_format = TextureFormat::Raw;
+	new_id();
 
 	// skip img id field
 	in.ignore(header.id_length);
@@ -76,6 +146,208 @@ bool Texture::load_tga_file(const std::string& filename)
 	std::cout << "texture loaded: " << filename
 		<< " | size: " << m_width << "x" << m_height
 		<< " | bpp: " << m_bytes_per_pixel * 8 << std::endl;
+
+	if (format != TextureFormat::Raw) return compress(format);
+	return true;
+}
+
+bool Texture::compress(TextureFormat format)
+{
+	if (m_format != TextureFormat::Raw || m_buffer.empty())
+	{
+		std::cerr << "error: only a loaded raw texture can be compressed" << std::endl;
+		return false;
+	}
+	if (format == TextureFormat::Raw) return true;
+
+	if (format == TextureFormat::BC1 && m_bytes_per_pixel == 4)
+	{
+		for (std::size_t i = 3; i < m_buffer.size(); i += 4)
+		{
+			if (m_buffer[i] != 255)
+			{
+				std::cerr << "texture has alpha, compressing as BC3 instead of BC1" << std::endl;
+				format = TextureFormat::BC3;
+				break;
+			}
+		}
+	}
+
+	int blocks_x = (m_width + 3) / 4;
+	int blocks_y = (m_height + 3) / 4;
+	int pad_rows = blocks_y * 4 - m_height;
+	int stride = block_bytes(format);
+	std::vector<std::uint8_t> blocks(static_cast<std::size_t>(blocks_x) * blocks_y * stride);
+
+	double squared_error = 0;
+	for (int by = 0; by < blocks_y; ++by)
+	{
+		for (int bx = 0; bx < blocks_x; ++bx)
+		{
+			// partial blocks at the right edge and the filler rows below row 0 repeat the nearest texel
+			Color texels[16];
+			for (int i = 0; i < 16; ++i)
+				texels[i] = texel(std::min(bx * 4 + i % 4, m_width - 1), std::max(by * 4 + i / 4 - pad_rows, 0));
+
+			std::uint8_t* block = &blocks[(static_cast<std::size_t>(by) * blocks_x + bx) * stride];
+			Color decoded[16];
+			if (format == TextureFormat::BC1)
+			{
+				encode_bc1_block(texels, block);
+				decode_bc1_block(block, decoded);
+			}
+			else
+			{
+				encode_bc3_block(texels, block);
+				decode_bc3_block(block, decoded);
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				if (bx * 4 + i % 4 >= m_width || by * 4 + i / 4 < pad_rows) continue;
+				int dr = texels[i].r - decoded[i].r, dg = texels[i].g - decoded[i].g, db = texels[i].b - decoded[i].b;
+				squared_error += dr * dr + dg * dg + db * db;
+			}
+		}
+	}
+
+	std::size_t raw_size = m_buffer.size();
+	m_buffer = std::move(blocks);
+	m_buffer.shrink_to_fit();
+	m_format = format;
+	m_blocks_x = blocks_x;
+	m_pad_rows = pad_rows;
+	new_id();
+
+	double mse = squared_error / (3.0 * m_width * m_height);
+	std::cout << "texture compressed: " << format_name(format)
+		<< " | " << raw_size / 1024 << " KiB -> " << m_buffer.size() / 1024 << " KiB"
+		<< " (" << static_cast<double>(raw_size) / m_buffer.size() << "x smaller)"
+		<< " | psnr: " << (mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0) << " dB" << std::endl;
+	return true;
+}
+
+// dds stores the top row first, in memory the bottom row is first (see load_tga_file).
+// dds pads a partial block row after the last (bottom) row, in memory the filler rows come before row 0
+// (m_pad_rows), so both grids line up with the picture's top row and the flip is by whole blocks
+static void flip_block_rows(std::vector<std::uint8_t>& blocks, TextureFormat format, int blocks_x, int height)
+{
+	int stride = block_bytes(format);
+	int blocks_y = (height + 3) / 4;
+	std::size_t row_bytes = static_cast<std::size_t>(blocks_x) * stride;
+	std::vector<std::uint8_t> row(row_bytes);
+	for (int by = 0; by < blocks_y / 2; ++by)
+	{
+		std::uint8_t* top = &blocks[by * row_bytes];
+		std::uint8_t* bottom = &blocks[(blocks_y - 1 - by) * row_bytes];
+		std::memcpy(row.data(), top, row_bytes);
+		std::memcpy(top, bottom, row_bytes);
+		std::memcpy(bottom, row.data(), row_bytes);
+	}
+	for (std::size_t offset = 0; offset < blocks.size(); offset += stride)
+	{
+		if (format == TextureFormat::BC1) flip_bc1_block(&blocks[offset]);
+		else flip_bc3_block(&blocks[offset]);
+	}
+}
+
+bool Texture::load_dds_file(const std::string& filename)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if (!in)
+	{
+		std::cerr << "error: cannot open texture file " << filename << std::endl;
+		return false;
+	}
+
+	DDSHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || header.magic != dds_magic || header.size != sizeof(DDSHeader) - sizeof(header.magic))
+	{
+		std::cerr << "error: cannot read DDS header from " << filename << std::endl;
+		return false;
+	}
+
+	TextureFormat format;
+	if (!(header.pixel_format.flags & ddpf_fourcc)) format = TextureFormat::Raw;
+	else if (header.pixel_format.four_cc == dds_fourcc_dxt1) format = TextureFormat::BC1;
+	else if (header.pixel_format.four_cc == dds_fourcc_dxt5) format = TextureFormat::BC3;
+	else format = TextureFormat::Raw;
+	if (format == TextureFormat::Raw || header.width == 0 || header.height == 0)
+	{
+		// DX10 extended headers, uncompressed and other block formats arent supported
+		std::cerr << "error: unsupported DDS format in " << filename << " (only DXT1/DXT5)" << std::endl;
+		return false;
+	}
+
+	m_width = header.width;
+	m_height = header.height;
+	m_bytes_per_pixel = 0;
+	m_blocks_x = (m_width + 3) / 4;
+	m_pad_rows = (m_height + 3) / 4 * 4 - m_height;
+	m_format = format;
+	new_id();
+
+	// top mip level only, the rest of the file is ignored
+	std::size_t buffer_size = static_cast<std::size_t>(m_blocks_x) * ((m_height + 3) / 4) * block_bytes(format);
+	m_buffer.resize(buffer_size);
+	m_buffer.shrink_to_fit();
+	in.read(reinterpret_cast<char*>(m_buffer.data()), buffer_size);
+	if (!in)
+	{
+		std::cerr << "error: cannot read block data from " << filename << std::endl;
+		m_buffer.clear();
+		return false;
+	}
+	flip_block_rows(m_buffer, m_format, m_blocks_x, m_height);
+
+	std::cout << "texture loaded: " << filename
+		<< " | size: " << m_width << "x" << m_height
+		<< " | " << format_name(m_format) << " | " << m_buffer.size() / 1024 << " KiB" << std::endl;
+	return true;
+}
+
+bool Texture::write_dds_file(const std::string& filename) const
+{
+	if (m_format == TextureFormat::Raw)
+	{
+		std::cerr << "error: only compressed textures can be saved as DDS" << std::endl;
+		return false;
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	if (!out)
+	{
+		std::cerr << "error: cant open file " << filename << " to write" << std::endl;
+		return false;
+	}
+
+	DDSHeader header = {};
+	header.magic = dds_magic;
+	header.size = sizeof(DDSHeader) - sizeof(header.magic);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000; // caps, height, width, pixel format, linear size
+	header.height = m_height;
+	header.width = m_width;
+	header.linear_size = static_cast<std::uint32_t>(m_buffer.size());
+	header.mip_map_count = 1;
+	header.pixel_format.size = sizeof(DDSPixelFormat);
+	header.pixel_format.flags = ddpf_fourcc;
+	header.pixel_format.four_cc = m_format == TextureFormat::BC1 ? dds_fourcc_dxt1 : dds_fourcc_dxt5;
+	header.caps = 0x1000; // texture
+
+	std::vector<std::uint8_t> blocks = m_buffer;
+	flip_block_rows(blocks, m_format, m_blocks_x, m_height);
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+	out.close();
+	if (!out)
+	{
+		std::cerr << "error: something bad happened while writing " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "texture saved to " << filename << std::endl;
 	return true;
 }
 
@@ -92,6 +364,13 @@ Color Texture::sample(float u, float v) const
 	int y = static_cast<int>(v * (m_height - 1));
 	//int y = static_cast<int>((1.0f - v) * (m_height - 1)); // flip V coordinate
 
+	return texel(x, y);
+}
+
+Color Texture::texel(int x, int y) const
+{
+	if (m_format != TextureFormat::Raw) return compressed_texel(x, y);
+
 	// calculate the index in the 1d buffer
 	int index = (y * m_width + x) * m_bytes_per_pixel;
 
@@ -103,3 +382,25 @@ Color Texture::sample(float u, float v) const
 
 	return Color(r, g, b, a);
 }
+
+Color Texture::compressed_texel(int x, int y) const
+{
+	y += m_pad_rows;
+	int bx = x >> 2;
+	int by = y >> 2;
+	std::uint32_t block_index = static_cast<std::uint32_t>(by * m_blocks_x + bx);
+	std::uint64_t key = (static_cast<std::uint64_t>(m_id) << 32) | block_index;
+
+	DecodedBlock& cached = decoded_block_cache[((bx & 15) | ((by & 15) << 4)) ^ (m_id & (decoded_block_cache_size - 1))];
+	if (cached.key != key)
+	{
+		const std::uint8_t* block = &m_buffer[static_cast<std::size_t>(block_index) * block_bytes(m_format)];
+		Color texels[16];
+		if (m_format == TextureFormat::BC1) decode_bc1_block(block, texels);
+		else decode_bc3_block(block, texels);
+		std::memcpy(cached.texels, texels, sizeof(texels));
+		cached.key = key;
+	}
+	const std::uint8_t* c = cached.texels[((y & 3) << 2) | (x & 3)];
+	return Color(c[2], c[1], c[0], c[3]);
+}
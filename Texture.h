@@ -5,19 +5,48 @@
 #include <fstream>
 #include <iostream>
 
+// how the texels are kept in memory
+enum class TextureFormat {
+	Raw,  // 24/32 bpp bgr(a), as loaded from the TGA
+	BC1,  // 4x4 blocks, 8 bytes each (4 bpp), opaque
+	BC3,  // 4x4 blocks, 16 bytes each (8 bpp), BC1 color + interpolated alpha
+};
+
 class Texture {
 public:
 	Texture() = default;
 
-	// load texture from TGA file
-	bool load_tga_file(const std::string& filename);
+	// load texture from TGA file, optionally block-compressing it right away
+	bool load_tga_file(const std::string& filename, TextureFormat format = TextureFormat::Raw);
+	// load pre-encoded DXT1 (BC1) / DXT5 (BC3) texture from DDS file, only the top mip level is used
+	bool load_dds_file(const std::string& filename);
+	// save a compressed texture as DDS so it can be loaded pre-encoded next time
+	bool write_dds_file(const std::string& filename) const;
+
+	// re-encode raw texels as BC1/BC3. BC1 falls back to BC3 if the texture has non-opaque alpha
+	bool compress(TextureFormat format);
 
 	// get color at uv coords (u,v in [0,1])
 	Color sample(float u, float v) const;
+	// get color of a single texel, no bounds check
+	Color texel(int x, int y) const;
+
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	TextureFormat get_format() const { return m_format; }
+	// resident bytes of texel data
+	std::size_t get_memory_size() const { return m_buffer.size(); }
 
 private:
 	int m_width = 0;
 	int m_height = 0;
 	int m_bytes_per_pixel = 0;
-	std::vector<std::uint8_t> m_buffer;  // raw pixel data
-};
\ No newline at end of file
+	TextureFormat m_format = TextureFormat::Raw;
+	int m_blocks_x = 0;  // blocks per row when compressed
+	int m_pad_rows = 0;  // filler rows below row 0 when compressed, so the picture's top row starts a block row (see flip_block_rows)
+	std::uint32_t m_id = 0;  // tags this texture's blocks in the decoded-block cache, changes whenever m_buffer does
+	std::vector<std::uint8_t> m_buffer;  // raw pixel data or 4x4 blocks, row-major
+
+	Color compressed_texel(int x, int y) const;
+	void new_id();
+};
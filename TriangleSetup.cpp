@@ -0,0 +1,67 @@
+#include "TriangleSetup.h"
+#include <cmath> //std::abs
+#include <atomic>
+#include <iostream>
+
+bool TriangleSetup::setup(const Vec3f v_screen[3], const float* const vertex_varyings[3], int count)
+{
+	if (count < 0 || count > max_varyings)
+	{
+		// would read past the planes, refuse the triangle instead of dropping varyings. once, not per triangle
+		static std::atomic<bool> reported{ false };
+		if (!reported.exchange(true))
+			std::cerr << "error: shader has " << count << " varyings, triangle setup handles up to " << max_varyings << std::endl;
+		return false;
+	}
+
+	const Vec3f& v0 = v_screen[0];
+	const Vec3f& v1 = v_screen[1];
+	const Vec3f& v2 = v_screen[2];
+
+	// twice the signed area
+	float area2 = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::abs(area2) < 1.0f) return false; // triangle is degenerate
+
+	// barycentric weights of v1 and v2 as planes, v0's weight is whatever is left
+	float inv_area2 = 1.0f / area2;
+	Plane& e1 = edge[1];
+	e1.a = (v2.y - v0.y) * inv_area2;
+	e1.b = -(v2.x - v0.x) * inv_area2;
+	e1.c = (v0.y * (v2.x - v0.x) - v0.x * (v2.y - v0.y)) * inv_area2;
+
+	Plane& e2 = edge[2];
+	e2.a = -(v1.y - v0.y) * inv_area2;
+	e2.b = (v1.x - v0.x) * inv_area2;
+	e2.c = (v0.x * (v1.y - v0.y) - v0.y * (v1.x - v0.x)) * inv_area2;
+
+	edge[0].a = -e1.a - e2.a;
+	edge[0].b = -e1.b - e2.b;
+	edge[0].c = 1.0f - e1.c - e2.c;
+
+	// value f_i at vertex i -> plane through the three vertices
+	auto make_plane = [&](float f0, float f1, float f2)
+	{
+		float d1 = f1 - f0;
+		float d2 = f2 - f0;
+		Plane p;
+		p.a = e1.a * d1 + e2.a * d2;
+		p.b = e1.b * d1 + e2.b * d2;
+		p.c = f0 + e1.c * d1 + e2.c * d2;
+		return p;
+	};
+
+	float inv_w0 = 1.0f / v0.z;
+	float inv_w1 = 1.0f / v1.z;
+	float inv_w2 = 1.0f / v2.z;
+	inv_w = make_plane(inv_w0, inv_w1, inv_w2);
+
+	varying_count = count;
+	for (int i = 0; i < varying_count; ++i)
+	{
+		varyings[i] = make_plane(vertex_varyings[0][i] * inv_w0,
+			vertex_varyings[1][i] * inv_w1,
+			vertex_varyings[2][i] * inv_w2);
+	}
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Vec.h"
+
+const int max_varyings = 16;
+
+// screen-space plane equation f(x, y) = a * x + b * y + c
+struct Plane {
+	float a = 0;
+	float b = 0;
+	float c = 0;
+
+	float at(float x, float y) const { return a * x + b * y + c; }
+};
+
+// per-triangle setup, done once before rasterization:
+// edge functions for coverage, 1/w and every varying divided by w as screen-space planes.
+// the rasterizer steps the planes along each span (one add per value and pixel)
+// and recovers perspective-correct varyings with a single 1/(1/w) per pixel
+struct TriangleSetup {
+	Plane edge[3]; // barycentric weight of vertex i, the pixel is covered when all three are >= 0
+	Plane inv_w;
+	Plane varyings[max_varyings]; // varying / w
+	int varying_count = 0;
+
+	// v_screen[i].z holds clip w. varyings[i] points to count floats of vertex i.
+	// returns false for degenerate triangles (less than half a pixel of area) and for count > max_varyings
+	bool setup(const Vec3f v_screen[3], const float* const varyings[3], int count);
+};
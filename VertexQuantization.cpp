@@ -0,0 +1,58 @@
+#include "VertexQuantization.h"
+#include <algorithm> //std::min, std::max
+
+std::uint16_t quantize_unorm16(float value, float min, float extent)
+{
+	if (extent <= 0.0f) return 0; // flat axis, everything sits at min
+	float t = std::max(0.0f, std::min(1.0f, (value - min) / extent));
+	return static_cast<std::uint16_t>(t * 65535.0f + 0.5f);
+}
+
+static std::int16_t to_snorm16(float value)
+{
+	float clamped = std::max(-1.0f, std::min(1.0f, value));
+	return static_cast<std::int16_t>(std::floor(clamped * 32767.0f));
+}
+
+static std::uint32_t pack_octahedral(std::int16_t x, std::int16_t y)
+{
+	return static_cast<std::uint16_t>(x) | (static_cast<std::uint32_t>(static_cast<std::uint16_t>(y)) << 16);
+}
+
+std::uint32_t encode_octahedral(const Vec3f& n)
+{
+	// project onto the octahedron |x| + |y| + |z| = 1, then unfold the lower half
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 <= 0.0f) return pack_octahedral(0, 32767); // degenerate, store +z
+	float x = n.x / l1;
+	float y = n.y / l1;
+	if (n.z < 0)
+	{
+		float fx = (1.0f - std::abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float fy = (1.0f - std::abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	// rounding each axis independently isnt always closest on the sphere, keep the best of the 4 neighbours
+	std::int16_t base_x = to_snorm16(x);
+	std::int16_t base_y = to_snorm16(y);
+	std::uint32_t best = pack_octahedral(base_x, base_y);
+	float best_dot = -2.0f;
+	for (int dy = 0; dy <= 1; ++dy)
+	{
+		for (int dx = 0; dx <= 1; ++dx)
+		{
+			std::int16_t qx = static_cast<std::int16_t>(std::min(32767, base_x + dx));
+			std::int16_t qy = static_cast<std::int16_t>(std::min(32767, base_y + dy));
+			std::uint32_t candidate = pack_octahedral(qx, qy);
+			float d = decode_octahedral(candidate).normalize().dot(n);
+			if (d > best_dot)
+			{
+				best_dot = d;
+				best = candidate;
+			}
+		}
+	}
+	return best;
+}
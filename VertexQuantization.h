@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cmath> //std::abs
+#include "Vec.h"
+
+// compact vertex attributes, decoded in the vertex shader
+//   position: 3 x 16 bit unorm over the mesh bounding box (6 bytes instead of 12)
+//   uv:       2 x 16 bit unorm over the uv bounding box (4 bytes instead of 8)
+//   normal:   octahedral, 2 x 16 bit snorm packed in 32 bits (4 bytes instead of 12)
+
+struct QuantizedPosition {
+	std::uint16_t x, y, z;
+};
+
+struct QuantizedUV {
+	std::uint16_t u, v;
+};
+
+// value in [min, min + extent] -> 0..65535
+std::uint16_t quantize_unorm16(float value, float min, float extent);
+// unit vector -> octahedral map, x in the low 16 bits, y in the high 16 bits
+std::uint32_t encode_octahedral(const Vec3f& n);
+
+// scale = extent / 65535 per axis
+inline Vec3f dequantize_position(const QuantizedPosition& q, const Vec3f& min, const Vec3f& scale)
+{
+	return { min.x + q.x * scale.x, min.y + q.y * scale.y, min.z + q.z * scale.z };
+}
+
+inline Vec2f dequantize_uv(const QuantizedUV& q, const Vec2f& min, const Vec2f& scale)
+{
+	return { min.x + q.u * scale.x, min.y + q.v * scale.y };
+}
+
+// direction only, not unit length: normalize unless something downstream already does
+inline Vec3f decode_octahedral(std::uint32_t encoded)
+{
+	float x = static_cast<std::int16_t>(encoded & 0xFFFF) * (1.0f / 32767.0f);
+	float y = static_cast<std::int16_t>(encoded >> 16) * (1.0f / 32767.0f);
+	float z = 1.0f - std::abs(x) - std::abs(y);
+	if (z < 0)
+	{
+		// lower hemisphere is folded over the diagonals
+		float fx = (1.0f - std::abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float fy = (1.0f - std::abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	return { x, y, z };
+}
@@ -0,0 +1,441 @@
+// rasterizer benchmark suite
+// renders synthetic stress scenes (and african_head when the .obj is around) through render_model
+// and reports triangles/sec, fragments/sec and ns/pixel. *_vrsNxN runs are the same scene with coarse shading,
+// their fragment count is shader invocations. *_bc1 runs sample a block-compressed copy of the texture,
+// *_quantized runs use the compact vertex layout, *_dequantized runs are their float twins (same decoded values,
+// same coverage; a differing fragment count is flagged). vertex_stage_* runs only the vertex shader over every face,
+// their fragment count is 0 and ns/pixel is still per framebuffer pixel so they compare like the rest
+//
+// usage: bench [--save <baseline.csv>] [--compare <baseline.csv>] [--threshold <percent>]
+//              [--min-time <seconds>] [--filter <scene name substring>]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include "../Image.h"
+#include "../Model.h"
+#include "../Texture.h"
+#include "../PhongShader.h"
+#include "../Renderer.h"
+#include "../Mat4f.h"
+
+const int width = 800;
+const int height = 800;
+
+// same camera as main.cpp
+const Vec3f eye_pos = { 0, 0, 3 };
+const float fov_y = PI / 3.0f;
+
+struct BenchResult {
+	std::string name;
+	int triangles = 0;
+	long long fragments = 0;
+	double seconds = 0; // median time per frame
+	double triangles_per_sec = 0;
+	double fragments_per_sec = 0;
+	double ns_per_pixel = 0;
+};
+
+const Mat4f projection_matrix = Mat4f::perspective(fov_y, (float)width / (float)height, 0.1f, 100.0f);
+
+// screen-space point (pixels, view-space distance in front of the eye) back to world space,
+// so scenes can be laid out in pixels. the camera looks down -z, so view space is world space shifted by the eye
+Vec3f screen_to_world(float px, float py, float depth)
+{
+	const auto& p = projection_matrix.m;
+	float z_view = -depth;
+	float w = p[3][2] * z_view + p[3][3];
+	float ndc_x = px / width * 2.0f - 1.0f;
+	float ndc_y = 1.0f - py / height * 2.0f;
+	return { ndc_x * w / p[0][0] + eye_pos.x, ndc_y * w / p[1][1] + eye_pos.y, z_view + eye_pos.z };
+}
+
+// unindexed triangle facing the camera, screen winding v0 -> v1 -> v2 must be clockwise (y down) to survive culling
+void add_triangle(Model& model, const Vec3f s[3], const Vec2f uv[3])
+{
+	std::vector<FaceIndex> face;
+	for (int j = 0; j < 3; ++j)
+	{
+		int idx = static_cast<int>(model.vertices.size());
+		model.vertices.push_back(screen_to_world(s[j].x, s[j].y, s[j].z));
+		model.uvs.push_back(uv[j]);
+		model.normals.push_back({ 0, 0, 1 });
+		face.push_back({ idx, idx, idx });
+	}
+	model.faces.push_back(face);
+}
+
+// axis aligned quad in pixels as two triangles
+void add_quad(Model& model, float x0, float y0, float x1, float y1, float depth, Vec2f uv0 = { 0, 0 }, Vec2f uv1 = { 1, 1 })
+{
+	Vec3f a[3] = { { x0, y0, depth }, { x1, y0, depth }, { x0, y1, depth } };
+	Vec2f ua[3] = { { uv0.x, uv0.y }, { uv1.x, uv0.y }, { uv0.x, uv1.y } };
+	add_triangle(model, a, ua);
+	Vec3f b[3] = { { x1, y0, depth }, { x1, y1, depth }, { x0, y1, depth } };
+	Vec2f ub[3] = { { uv1.x, uv0.y }, { uv1.x, uv1.y }, { uv0.x, uv1.y } };
+	add_triangle(model, b, ub);
+}
+
+// ~2px triangles over the whole screen, setup and bounding box cost dominate
+Model scene_tiny_triangles()
+{
+	Model model;
+	const float cell = 4.0f;
+	for (float y = 0; y < height; y += cell)
+		for (float x = 0; x < width; x += cell)
+			add_quad(model, x, y, x + cell, y + cell, 3.0f, { x / width, y / height }, { (x + cell) / width, (y + cell) / height });
+	return model;
+}
+
+// two triangles covering the frame, pure per-pixel cost
+Model scene_large_triangles()
+{
+	Model model;
+	add_quad(model, 0, 0, (float)width, (float)height, 3.0f);
+	return model;
+}
+
+// full-screen quads drawn back to front, every layer passes the depth test
+Model scene_overdraw()
+{
+	Model model;
+	const int layers = 16;
+	for (int i = 0; i < layers; ++i)
+		add_quad(model, 0, 0, (float)width, (float)height, 3.5f - i * 0.05f);
+	return model;
+}
+
+// long 1px wide diagonal slivers, huge bounding boxes with almost no coverage
+Model scene_slivers()
+{
+	Model model;
+	for (int i = 0; i < 200; ++i)
+	{
+		float x = static_cast<float>(i * 4);
+		Vec3f s[3] = { { x, 0, 3.0f }, { x + 1.5f, 0, 3.0f }, { (float)width - x, (float)height, 3.0f } };
+		Vec2f uv[3] = { { 0, 0 }, { 1, 0 }, { 0.5f, 1 } };
+		add_triangle(model, s, uv);
+	}
+	return model;
+}
+
+// float layout holding a quantized model's decoded values. quantizing moves vertices by a tiny amount, enough to
+// change coverage where they sat exactly on the pixel grid, so *_quantized runs are compared against this twin
+// instead of the original scene: same coverage, only the vertex memory layout differs
+Model dequantized_twin(const Model& quantized)
+{
+	Model model;
+	model.faces = quantized.faces;
+	for (const auto& q : quantized.quantized_vertices)
+		model.vertices.push_back(dequantize_position(q, quantized.position_min, quantized.position_scale));
+	for (const auto& q : quantized.quantized_uvs) model.uvs.push_back(dequantize_uv(q, quantized.uv_min, quantized.uv_scale));
+	for (std::uint32_t n : quantized.quantized_normals) model.normals.push_back(decode_octahedral(n));
+	return model;
+}
+
+// small quads that each map the whole texture, every fragment lands far apart in texture memory
+Model scene_texture_minification()
+{
+	Model model;
+	const float cell = 16.0f;
+	for (float y = 0; y < height; y += cell)
+		for (float x = 0; x < width; x += cell)
+			add_quad(model, x, y, x + cell, y + cell, 3.0f);
+	return model;
+}
+
+BenchResult run_scene(const std::string& name, const Model& model, const Texture& texture, double min_time,
+	ShadingRate rate = ShadingRate::Rate1x1)
+{
+	Image image(width, height);
+	image.set_shading_rate(rate);
+
+	Mat4f model_matrix = Mat4f::identity();
+	Mat4f view_matrix = Mat4f::lookAt(eye_pos, { 0, 0, 0 }, { 0, 1, 0 });
+
+	PhongShader shader;
+	shader.model = &model;
+	shader.texture = &texture;
+	shader.uniform_mvp = projection_matrix * view_matrix * model_matrix;
+	shader.uniform_model_matrix = model_matrix;
+	shader.uniform_light_pos = { 5, 1, 3 };
+	shader.uniform_camera_pos = eye_pos;
+
+	// warm-up frame, also gives the per-frame counts
+	image.clear_buffers();
+	RenderStats stats = render_model(image, model, shader);
+
+	std::vector<double> times;
+	double total = 0;
+	while (total < min_time || times.size() < 3)
+	{
+		image.clear_buffers();
+		auto start = std::chrono::steady_clock::now();
+		render_model(image, model, shader);
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		times.push_back(t);
+		total += t;
+	}
+	std::sort(times.begin(), times.end());
+
+	BenchResult r;
+	r.name = name;
+	r.triangles = stats.triangles_in;
+	r.fragments = stats.fragments_shaded;
+	r.seconds = times[times.size() / 2];
+	r.triangles_per_sec = r.triangles / r.seconds;
+	r.fragments_per_sec = r.fragments / r.seconds;
+	r.ns_per_pixel = r.seconds * 1e9 / (width * height);
+	return r;
+}
+
+// vertex shader alone, every corner of every face, as render_model calls it
+BenchResult run_vertex_stage(const std::string& name, const Model& model, double min_time)
+{
+	PhongShader shader;
+	shader.model = &model;
+	shader.uniform_mvp = projection_matrix * Mat4f::lookAt(eye_pos, { 0, 0, 0 }, { 0, 1, 0 });
+	shader.uniform_model_matrix = Mat4f::identity();
+
+	float sink = 0; // keeps the calls from being optimized away
+	auto run = [&]()
+	{
+		for (int i = 0; i < static_cast<int>(model.faces.size()); ++i)
+			for (int j = 0; j < 3; ++j) sink += shader.vertex(i, j).w;
+	};
+
+	run();
+	std::vector<double> times;
+	double total = 0;
+	while (total < min_time || times.size() < 3)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		times.push_back(t);
+		total += t;
+	}
+	std::sort(times.begin(), times.end());
+	if (sink == 12345.0f) std::cout << ""; // never true in practice
+
+	BenchResult r;
+	r.name = name;
+	r.triangles = static_cast<int>(model.faces.size());
+	r.seconds = times[times.size() / 2];
+	r.triangles_per_sec = r.triangles / r.seconds;
+	r.ns_per_pixel = r.seconds * 1e9 / (width * height);
+	return r;
+}
+
+bool save_baseline(const std::string& filename, const std::vector<BenchResult>& results)
+{
+	std::ofstream out(filename);
+	if (!out)
+	{
+		std::cerr << "error: cant open file " << filename << " to write" << std::endl;
+		return false;
+	}
+
+	out << "scene,triangles,fragments,seconds,triangles_per_sec,fragments_per_sec,ns_per_pixel\n";
+	for (const auto& r : results)
+	{
+		out << r.name << "," << r.triangles << "," << r.fragments << "," << r.seconds << ","
+			<< r.triangles_per_sec << "," << r.fragments_per_sec << "," << r.ns_per_pixel << "\n";
+	}
+
+	std::cout << "baseline saved to " << filename << std::endl;
+	return static_cast<bool>(out);
+}
+
+bool load_baseline(const std::string& filename, std::map<std::string, BenchResult>& baseline)
+{
+	std::ifstream in(filename);
+	if (!in)
+	{
+		std::cerr << "error: cant open baseline " << filename << std::endl;
+		return false;
+	}
+
+	std::string line;
+	std::getline(in, line); // header
+	while (std::getline(in, line))
+	{
+		std::stringstream ss(line);
+		std::string field;
+		std::vector<std::string> fields;
+		while (std::getline(ss, field, ',')) fields.push_back(field);
+		if (fields.size() != 7) continue;
+
+		BenchResult r;
+		r.name = fields[0];
+		r.triangles = std::stoi(fields[1]);
+		r.fragments = std::stoll(fields[2]);
+		r.seconds = std::stod(fields[3]);
+		r.triangles_per_sec = std::stod(fields[4]);
+		r.fragments_per_sec = std::stod(fields[5]);
+		r.ns_per_pixel = std::stod(fields[6]);
+		baseline[r.name] = r;
+	}
+	return true;
+}
+
+// returns the number of scenes slower than baseline by more than threshold percent
+int compare_baseline(const std::map<std::string, BenchResult>& baseline, const std::vector<BenchResult>& results, double threshold)
+{
+	int regressions = 0;
+	for (const auto& r : results)
+	{
+		auto it = baseline.find(r.name);
+		if (it == baseline.end())
+		{
+			std::cout << "  " << r.name << ": not in baseline" << std::endl;
+			continue;
+		}
+
+		double change = (r.ns_per_pixel - it->second.ns_per_pixel) / it->second.ns_per_pixel * 100.0;
+		bool regressed = change > threshold;
+		if (regressed) regressions++;
+
+		std::cout << "  " << r.name << ": " << it->second.ns_per_pixel << " -> " << r.ns_per_pixel << " ns/pixel ("
+			<< (change >= 0 ? "+" : "") << change << "%)" << (regressed ? "  REGRESSION" : "") << std::endl;
+
+		if (r.fragments != it->second.fragments)
+			std::cout << "    note: fragment count changed " << it->second.fragments << " -> " << r.fragments << std::endl;
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv)
+{
+	std::string save_file;
+	std::string compare_file;
+	std::string filter;
+	double threshold = 5.0;
+	double min_time = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--save" && has_value) save_file = argv[++i];
+		else if (arg == "--compare" && has_value) compare_file = argv[++i];
+		else if (arg == "--threshold" && has_value) threshold = std::atof(argv[++i]);
+		else if (arg == "--min-time" && has_value) min_time = std::atof(argv[++i]);
+		else if (arg == "--filter" && has_value) filter = argv[++i];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--save <baseline.csv>] [--compare <baseline.csv>] [--threshold <percent>]"
+				<< " [--min-time <seconds>] [--filter <name>]" << std::endl;
+			return 2;
+		}
+	}
+
+	Texture texture;
+	if (!texture.load_tga_file("african_head_diffuse_uncomp.tga")) return -1;
+	Texture texture_bc1;
+	if (!texture_bc1.load_tga_file("african_head_diffuse_uncomp.tga", TextureFormat::BC1)) return -1;
+
+	std::vector<std::pair<std::string, Model>> scenes;
+	scenes.emplace_back("tiny_triangles", scene_tiny_triangles());
+	scenes.emplace_back("large_triangles", scene_large_triangles());
+	scenes.emplace_back("overdraw", scene_overdraw());
+	scenes.emplace_back("slivers", scene_slivers());
+	scenes.emplace_back("texture_minification", scene_texture_minification());
+	Model head("african_head.obj");
+	if (!head.faces.empty()) scenes.emplace_back("african_head", std::move(head));
+	else std::cerr << "african_head.obj not found, skipping that scene" << std::endl;
+
+	// coarse shading variants, run right after their full-rate scene
+	std::map<std::string, std::vector<ShadingRate>> coarse_rates = {
+		{ "large_triangles", { ShadingRate::Rate2x2, ShadingRate::Rate4x4 } },
+		{ "african_head", { ShadingRate::Rate2x2, ShadingRate::Rate4x4 } },
+	};
+	// scenes where texture sampling matters, rerun with the BC1 texture
+	std::vector<std::string> compressed_runs = { "large_triangles", "texture_minification", "african_head" };
+	// geometry heavy scenes, rerun with the compact vertex layout next to its float twin, end to end and vertex stage only
+	std::map<std::string, Model> quantized;
+	std::map<std::string, Model> dequantized;
+	for (const auto& scene : scenes)
+	{
+		if (scene.first != "tiny_triangles" && scene.first != "african_head") continue;
+		quantized[scene.first] = scene.second;
+		quantized[scene.first].quantize();
+		dequantized[scene.first] = dequantized_twin(quantized[scene.first]);
+	}
+
+	std::vector<BenchResult> results;
+	for (const auto& scene : scenes)
+	{
+		struct Run {
+			std::string name;
+			ShadingRate rate;
+			const Texture* texture;
+			const Model* model;
+			bool vertex_stage_only;
+			std::string twin; // run that must shade the same fragments for the comparison to mean anything
+		};
+		std::vector<Run> runs = { { scene.first, ShadingRate::Rate1x1, &texture, &scene.second, false } };
+		for (ShadingRate rate : coarse_rates[scene.first])
+		{
+			int r = static_cast<int>(rate);
+			runs.push_back({ scene.first + "_vrs" + std::to_string(r) + "x" + std::to_string(r), rate, &texture, &scene.second, false });
+		}
+		if (std::find(compressed_runs.begin(), compressed_runs.end(), scene.first) != compressed_runs.end())
+			runs.push_back({ scene.first + "_bc1", ShadingRate::Rate1x1, &texture_bc1, &scene.second, false });
+		if (quantized.count(scene.first))
+		{
+			const Model* q = &quantized[scene.first];
+			const Model* twin = &dequantized[scene.first];
+			runs.push_back({ scene.first + "_dequantized", ShadingRate::Rate1x1, &texture, twin, false });
+			runs.push_back({ scene.first + "_quantized", ShadingRate::Rate1x1, &texture, q, false, scene.first + "_dequantized" });
+			runs.push_back({ "vertex_stage_" + scene.first, ShadingRate::Rate1x1, &texture, &scene.second, true });
+			runs.push_back({ "vertex_stage_" + scene.first + "_quantized", ShadingRate::Rate1x1, &texture, q, true });
+		}
+
+		for (const auto& run : runs)
+		{
+			if (!filter.empty() && run.name.find(filter) == std::string::npos) continue;
+
+			BenchResult r = run.vertex_stage_only
+				? run_vertex_stage(run.name, *run.model, min_time)
+				: run_scene(run.name, *run.model, *run.texture, min_time, run.rate);
+			std::cout << r.name
+				<< " | triangles: " << r.triangles
+				<< " | fragments: " << r.fragments
+				<< " | " << r.seconds * 1e3 << " ms"
+				<< " | " << r.triangles_per_sec / 1e6 << " Mtri/s"
+				<< " | " << r.fragments_per_sec / 1e6 << " Mfrag/s"
+				<< " | " << r.ns_per_pixel << " ns/pixel" << std::endl;
+
+			auto twin = std::find_if(results.begin(), results.end(), [&](const BenchResult& t) { return t.name == run.twin; });
+			if (twin != results.end() && twin->fragments != r.fragments)
+				std::cout << "    warning: " << twin->fragments << " fragments in " << run.twin << " vs " << r.fragments
+					<< ", the timings arent comparable" << std::endl;
+			results.push_back(r);
+		}
+	}
+
+	if (!save_file.empty() && !save_baseline(save_file, results)) return -1;
+
+	if (!compare_file.empty())
+	{
+		std::map<std::string, BenchResult> baseline;
+		if (!load_baseline(compare_file, baseline)) return -1;
+
+		std::cout << "comparing against " << compare_file << " (threshold " << threshold << "%)" << std::endl;
+		int regressions = compare_baseline(baseline, results, threshold);
+		if (regressions > 0)
+		{
+			std::cout << regressions << " regression(s) above threshold" << std::endl;
+			return 1;
+		}
+		std::cout << "no regressions" << std::endl;
+	}
+
+	return 0;
+}
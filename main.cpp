@@ -1,5 +1,8 @@
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
 #include "Image.h"
 #include "Color.h"
 #include "Vec.h"
@@ -7,6 +10,10 @@
 #include "Model.h"
 #include "Texture.h"
 #include "PhongShader.h"
+#include "Renderer.h"
+#include "Profiler.h"
+#include "SharedFramebuffer.h"
+#include "StreamingModel.h"
 
 // hard-coded cube model
 //Model create_cube() {
@@ -56,18 +63,101 @@ Vec3f project(const Vec3f& v, const Mat4f& mvp, int width, int height) {
     return { screen_x, screen_y, w };
 }
 
-int main()
+// usage: software-Rasterizer [--shm <name>] [--light-sweep <frames>] [--vrs <2|4|auto>] [--rate-image <file.tga>]
+//                             [--texture <file.tga|file.dds>] [--texture-format <raw|bc1|bc3>] [--save-dds <file.dds>]
+//                             [--stream <budget MiB>] [--poster <width>x<height> <file.ppm|file.tga>] [--strip-rows <rows>]
+//                             [--quantize]
+//   --shm <name>            also publish the frame to a shared-memory ring (see SharedFramebuffer.h) for live viewers
+//   --light-sweep <frames>  orbit the light for that many extra frames, relit from the surface cache
+//   --vrs <2|4|auto>        coarse shading, 2x2/4x4 for the whole draw or per tile from a full-rate frame's luminance
+//   --rate-image <file.tga> coarse shading per tile from a rate image (red: <85 1x1, <170 2x2, else 4x4)
+//   --texture <file>        diffuse map, .dds files (DXT1/DXT5) stay block-compressed in memory
+//   --texture-format <fmt>  block-compress a .tga texture at load time
+//   --save-dds <file.dds>   save the compressed texture, to load it pre-encoded next time
+//   --stream <budget MiB>   out-of-core render, the model is streamed in chunks instead of loaded (see StreamingModel.h)
+//   --poster <w>x<h> <file> render at any size in horizontal strips streamed to the file (.ppm has no size limit)
+//   --strip-rows <rows>     strip height for --poster, memory is about width * rows * 8 bytes (default 256)
+//   --quantize              keep the model in the compact vertex layout (see VertexQuantization.h)
+int main(int argc, char** argv)
 {
+    std::string shm_name;
+    int sweep_frames = 0;
+    std::string vrs_mode;
+    std::string rate_image_file;
+    std::string texture_file = "african_head_diffuse_uncomp.tga";
+    TextureFormat texture_format = TextureFormat::Raw;
+    std::string save_dds_file;
+    int stream_budget_mb = 0;
+    int poster_width = 0;
+    int poster_height = 0;
+    std::string poster_file;
+    int strip_rows = 256;
+    bool quantize = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--shm" && i + 1 < argc) shm_name = argv[++i];
+        else if (arg == "--light-sweep" && i + 1 < argc) sweep_frames = std::atoi(argv[++i]);
+        else if (arg == "--vrs" && i + 1 < argc) vrs_mode = argv[++i];
+        else if (arg == "--rate-image" && i + 1 < argc) rate_image_file = argv[++i];
+        else if (arg == "--texture" && i + 1 < argc) texture_file = argv[++i];
+        else if (arg == "--texture-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "bc1") texture_format = TextureFormat::BC1;
+            else if (format == "bc3") texture_format = TextureFormat::BC3;
+        }
+        else if (arg == "--save-dds" && i + 1 < argc) save_dds_file = argv[++i];
+        else if (arg == "--stream" && i + 1 < argc) stream_budget_mb = std::atoi(argv[++i]);
+        else if (arg == "--poster" && i + 2 < argc)
+        {
+            std::string size = argv[++i];
+            std::size_t x = size.find('x');
+            if (x != std::string::npos)
+            {
+                poster_width = std::atoi(size.substr(0, x).c_str());
+                poster_height = std::atoi(size.substr(x + 1).c_str());
+            }
+            poster_file = argv[++i];
+        }
+        else if (arg == "--strip-rows" && i + 1 < argc) strip_rows = std::atoi(argv[++i]);
+        else if (arg == "--quantize") quantize = true;
+    }
+
     const int width = 800;
     const int height = 800;
     const float aspect_ratio = (float)width / (float)height;
 
     Image my_image(width, height);
+    // a poster is the profiled frame when there is one
+    PROFILE_BEGIN_FRAME(poster_file.empty() ? width : poster_width, poster_file.empty() ? height : poster_height);
 
 	// load model and texture
-    Model model("african_head.obj");
+    Model model;
+    bool streaming = stream_budget_mb > 0;
+    StreamingModel streaming_model(static_cast<std::size_t>(std::max(stream_budget_mb, 1)) << 20);
+    {
+        PROFILE_SCOPE("load model");
+        if (!streaming) model = Model("african_head.obj");
+        else if (!streaming_model.open("african_head.obj")) return -1;
+        if (quantize) model.quantize();
+    }
+    if (streaming && (!vrs_mode.empty() || !rate_image_file.empty() || sweep_frames > 0))
+    {
+        // both rerender or relight from a resident model
+        std::cerr << "--vrs, --rate-image and --light-sweep are ignored with --stream" << std::endl;
+        vrs_mode.clear();
+        rate_image_file.clear();
+        sweep_frames = 0;
+    }
     Texture texture;
-    if (!texture.load_tga_file("african_head_diffuse_uncomp.tga")) return -1;
+    {
+        PROFILE_SCOPE("load texture");
+        bool is_dds = texture_file.size() > 4 && texture_file.compare(texture_file.size() - 4, 4, ".dds") == 0;
+        if (is_dds ? !texture.load_dds_file(texture_file) : !texture.load_tga_file(texture_file, texture_format)) return -1;
+        std::cout << "texture memory: " << texture.get_memory_size() / 1024 << " KiB" << std::endl;
+        if (!save_dds_file.empty()) texture.write_dds_file(save_dds_file);
+    }
 
     // transformations
     Vec3f eye_pos = { 0, 0, 3 };
@@ -91,45 +181,114 @@ int main()
     shader.uniform_light_pos = light_pos;
     shader.uniform_camera_pos = eye_pos;
 
+    // poster: its own aspect ratio, strips go straight to disk and nothing else runs
+    if (!poster_file.empty())
+    {
+        if (streaming || poster_width <= 0 || poster_height <= 0)
+        {
+            std::cerr << "error: --poster needs a <width>x<height> size and a resident model (no --stream)" << std::endl;
+            return -1;
+        }
+
+        Mat4f poster_projection = Mat4f::perspective(PI / 3.0f, (float)poster_width / (float)poster_height, 0.1f, 100.0f);
+        shader.uniform_mvp = poster_projection * view_matrix * model_matrix;
+
+        auto start = std::chrono::steady_clock::now();
+        RenderStats poster_stats;
+        if (!render_model_strips(model, shader, poster_width, poster_height, strip_rows, poster_file, poster_stats)) return -1;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "poster saved to " << poster_file << " | " << poster_width << "x" << poster_height
+            << " | strips of " << strip_rows << " rows | " << seconds << " s"
+            << " | fragments: " << poster_stats.fragments_shaded << std::endl;
+        PROFILE_REPORT("trace.json", "overdraw.tga");
+        return 0;
+    }
+
     // clear buffers
     my_image.clear_buffers();
 
-	// render loop
-    for (int i = 0; i < model.faces.size(); ++i)
+    // variable-rate shading, measured against a full-rate reference frame
+    bool vrs = !vrs_mode.empty() || !rate_image_file.empty();
+    ShadingRateMap rate_map(width, height);
+    Image reference(vrs ? width : 0, vrs ? height : 0);
+    RenderStats reference_stats;
+    if (vrs)
     {
-        const auto& face_indices = model.faces[i];
-        if (face_indices.size() != 3) continue;
+        PROFILE_SCOPE("vrs reference");
+        reference.clear_buffers();
+        reference_stats = render_model(reference, model, shader);
 
-		// run vertex shader for each vertex of the triangle
-        Vec4f clip_coords[3];
-        for (int j = 0; j < 3; ++j) clip_coords[j] = shader.vertex(i, j);
+        if (vrs_mode == "2") my_image.set_shading_rate(ShadingRate::Rate2x2);
+        else if (vrs_mode == "4") my_image.set_shading_rate(ShadingRate::Rate4x4);
+        else if (vrs_mode == "auto")
+        {
+            // a real frame loop would use the previous frame, here the reference stands in for it
+            rate_map.from_luminance_gradient(reference);
+            my_image.set_shading_rate_map(&rate_map);
+        }
 
-		// project to screen space
-        Vec3f v_screen[3];
-        for (int j = 0; j < 3; ++j)
+        Texture rate_image;
+        if (!rate_image_file.empty() && rate_image.load_tga_file(rate_image_file))
         {
-            Vec3f ndc = clip_coords[j].to_vec3f();
-            float screen_x = (ndc.x + 1.0f) * 0.5f * width;
-            float screen_y = (1.0f - ndc.y) * 0.5f * height; // flip Y
-            v_screen[j] = { screen_x, screen_y, clip_coords[j].w }; // store w for depth
+            rate_map.from_rate_image(rate_image);
+            my_image.set_shading_rate_map(&rate_map);
         }
+    }
 
-		// back-face culling
-        Vec3f v0_screen = { v_screen[0].x, v_screen[0].y, 0 };
-        Vec3f v1_screen = { v_screen[1].x, v_screen[1].y, 0 };
-        Vec3f v2_screen = { v_screen[2].x, v_screen[2].y, 0 };
-        Vec3f normal_screen = (v1_screen - v0_screen).cross(v2_screen - v0_screen).normalize();
+	// render, keeping the surfaces around for relighting
+    SurfaceCache surface_cache;
+    RenderStats stats;
+    {
+        PROFILE_SCOPE("render");
+        if (streaming) stats = streaming_model.render(my_image, shader);
+        else stats = render_model_cached(my_image, model, shader, surface_cache);
+    }
+
+    if (vrs)
+    {
+        ImageError error = compare_images(my_image, reference);
+        std::cout << "vrs: shader invocations " << reference_stats.fragments_shaded << " -> " << stats.fragments_shaded
+            << " (" << (double)reference_stats.fragments_shaded / std::max(1LL, stats.fragments_shaded) << "x fewer)"
+            << " | rmse: " << error.rmse << " | psnr: " << error.psnr << " dB | max error: " << error.max_error << std::endl;
+    }
 
-        if (normal_screen.z < 0) continue; // cull
+    // publish for live consumers
+    SharedFramebuffer shared_framebuffer;
+    bool publishing = !shm_name.empty() && shared_framebuffer.create(shm_name, width, height);
+    if (publishing)
+    {
+        PROFILE_SCOPE("publish shm");
+        shared_framebuffer.publish(my_image);
+    }
 
-        // draw triangle
-        my_image.drawTriangle(v_screen, shader);
+    // light sweep, camera and geometry stay put so every frame only reruns the lighting
+    if (sweep_frames > 0)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 1; frame <= sweep_frames; ++frame)
+        {
+            float angle = 2.0f * PI * frame / sweep_frames;
+            shader.uniform_light_pos = { 5.0f * std::cos(angle), 1.0f, 5.0f * std::sin(angle) + 3.0f };
+            render_model_cached(my_image, model, shader, surface_cache);
+            if (publishing) shared_framebuffer.publish(my_image);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "light sweep: " << sweep_frames << " frames | " << ms / sweep_frames << " ms/frame" << std::endl;
     }
 
     // save
     const std::string filename = "output.tga";
-    if (my_image.write_tga_file(filename, false)) std::cout << "Image saved successfully to " << filename << std::endl;
+    bool saved;
+    {
+        PROFILE_SCOPE("write tga");
+        saved = my_image.write_tga_file(filename, false);
+    }
+    if (saved) std::cout << "Image saved successfully to " << filename << std::endl;
     else std::cerr << "Error saving image." << std::endl;
 
+    // trace and overdraw heatmap, profiling builds only
+    PROFILE_REPORT("trace.json", "overdraw.tga");
+
     return 0;
 }